@@ -1,17 +1,67 @@
+#define _POSIX_C_SOURCE 200809L
+#define _DEFAULT_SOURCE
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <ctype.h>
 #include <stdarg.h>
 #include <stdbool.h>
 #include <string.h>
+#include <stdint.h>
 #include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
 
 #define MAX_MOVE_SIZE 10
 #define CHUNK_SIZE 50
 #define BOARD_SIZE 8
 #define BUFFER_SIZE 100
+#define HISTORY_SIZE 128
+#define MAX_MOVES 256
+#define MAX_THREADS 64
+#define MAX_PLY 64
+#define INFINITE_SCORE 32000
+#define MATE_SCORE 31000
+#define CLUSTER_SIZE 4
+#define HUGE_PAGE_SIZE ((size_t)2 << 20)
+#define DEFAULT_HASH_SIZE 16
+#define MAX_HASH_SIZE 65536
+#define UCI_BUFFER_SIZE 16384
+#define START_POSITION "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1"
+#define PERFT_SUITE_SIZE 6
+#define PERFT_SUITE_DEPTH 5
+#define ILLEGAL_SUITE_SIZE 2
+#define PGN_BATCH_GAMES 256
+#define PGN_BATCH_SIZE ((size_t)1 << 20)
+#define FEN_WINDOW_SIZE ((size_t)64 << 20)
+#define ARCHIVE_MAGIC "TCARCHV1"
+#define INDEX_MAGIC "TCINDEX1"
+#define ARCHIVE_WINDOW_GAMES 65536
+#define NO_CLOCK 0xFFFFFFFF
+#define NO_EVAL (-32768)
+#define POLYGLOT_KEY_COUNT 781
+#define BOOK_PLIES 20
+#define MAX_BITBASES 40
+#define BITBASE_MAGIC "TCBITBS1"
+#define DEFAULT_BITBASE_DIRECTORY "bitbases"
+#define KNOWN_WIN_SCORE 20000 // Score of a won bitbase position, kept below the mate scores
+#define NETWORK_MAGIC "TCNETWK1"
+#define NETWORK_INPUTS 768 // One input for every piece on every square
+#define NETWORK_SIZE 256 // Hidden neurons per side
+#define NETWORK_WEIGHT_COUNT (NETWORK_INPUTS * NETWORK_SIZE + NETWORK_SIZE + 2 * NETWORK_SIZE + 1)
+#define NETWORK_QA 255 // The hidden layer is quantized to this many steps per unit and clipped to one unit
+#define NETWORK_QB 64 // Steps per unit of the output weights
+#define NETWORK_SCALE 400 // Centipawns per unit of the output
+#define EVALUATION_BENCH_DEPTH 4
+#define HISTORY_LIMIT 16384 // History scores stay between minus and plus this
 #define White "White"
 #define Black "Black"
+#define PIECE_SYMBOLS "PNBRQKpnbrqk"
+#define LIGHT_SQUARES 0xAA55AA55AA55AA55ULL
+#define BACK_RANKS 0xFF000000000000FFULL
 
 #define GET_INPUT(...)                                  \
     printf(__VA_ARGS__);                                \
@@ -33,14 +83,106 @@
         goto exit;                                      \
     }
 
-#define isKnightMove(pos1, pos2) ((abs((pos1).row - (pos2).row) == 2 * abs((pos1).col - (pos2).col)) || (abs((pos1).col - (pos2).col) == 2 * abs((pos1).row - (pos2).row)))
-#define comparePositions(pos1, pos2) ((pos1).col == (pos2).col && (pos1).row == (pos2).row)
-#define hasSameColor(piece, isWhite) strchr((isWhite) ? "PRNBQK" : "prnbqk", (piece))
-#define getRegPos(kingPos) (Position){(kingPos).row, (kingPos).col}
-#define boardAt(pos) board[(pos).row][(pos).col]
+#define bit(square) ((Bitboard)1 << (square))
+#define createMove(type, origin, destination) ((Move)((origin) | (destination) << 6 | (type) << 12))
+#define moveOrigin(move) ((move) & 63)
+#define moveDestination(move) ((move) >> 6 & 63)
+#define moveType(move) ((MoveType)((move) >> 12))
+#define isPromotion(move) ((move) >= PROMOTION << 12)
+#define promotionSet(move) ((PieceSet)((move) >> 12 & 7))
+#define isCapture(bitboards, move) (((bitboards)->occupied & bit(moveDestination(move))) || moveType(move) == ENPEASANT)
+// Everything algebraic notation can say about a move: destination in the lowest 6 bits, then the PieceSet, capture, promotion PieceSet, origin file and rank and castling side
+#define sanKey(set, destination, captures, promotion, col, row, castle) ((uint32_t)(destination) | (uint32_t)(set) << 6 | (uint32_t)(captures) << 9 | (uint32_t)(promotion) << 10 | (uint32_t)(col) << 13 | (uint32_t)(row) << 16 | (uint32_t)(castle) << 19)
+#define SAN_TARGET_MASK 0x1FFU
+#define SAN_COL_MASK (7U << 13)
+#define SAN_ROW_MASK (7U << 16)
+#define SAN_CASTLE_MASK (3U << 19)
+#define onBoard(row, col) (0 <= (row) && (row) < BOARD_SIZE && 0 <= (col) && (col) < BOARD_SIZE)
+#define sideOf(isWhite) ((isWhite) ? WHITE : BLACK)
+#define pieceIndex(piece) (strchr(PIECE_SYMBOLS, (piece)) - PIECE_SYMBOLS)
+#define rowMask(row) (0xFFULL << ((row) * BOARD_SIZE))
+#define colMask(col) (0x0101010101010101ULL << (col))
+#define packEntry(move, score, depth, bound, generation) ((uint64_t)(move) | (uint64_t)(uint16_t)(score) << 16 | (uint64_t)(depth) << 32 | (uint64_t)(bound) << 40 | (uint64_t)(generation) << 48)
+#define entryMove(data) ((uint16_t)(data))
+#define entryScore(data) ((int16_t)((data) >> 16))
+#define entryDepth(data) ((unsigned char)((data) >> 32))
+#define entryBound(data) ((Bound)(((data) >> 40) & 3))
+#define entryGeneration(data) ((unsigned char)((data) >> 48))
+// Mate scores are stored relative to the position instead of the root, so they stay right wherever the position is found again
+#define scoreToTable(score, ply) ((score) >= MATE_SCORE - MAX_PLY ? (score) + (ply) : (score) <= MAX_PLY - MATE_SCORE ? (score) - (ply) : (score))
+#define scoreFromTable(score, ply) ((score) >= MATE_SCORE - MAX_PLY ? (score) - (ply) : (score) <= MAX_PLY - MATE_SCORE ? (score) + (ply) : (score))
+#define bishopAttacks(square, occupied) (bishopMagics[square].attacks[magicIndex(&bishopMagics[square], (occupied))])
+#define rookAttacks(square, occupied) (rookMagics[square].attacks[magicIndex(&rookMagics[square], (occupied))])
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#define magicIndex(entry, occupied) _pext_u64((occupied), (entry)->mask)
+#else
+#define magicIndex(entry, occupied) ((((occupied) & (entry)->mask) * (entry)->magic) >> (entry)->shift)
+#endif
+
+// The input of a piece on a square to the hidden layer of one side, given as its index into PIECE_SYMBOLS times 64 plus its square.
+// Each side sees its own pieces first and the board from its own back rank, so one set of weights serves both
+#define networkFeature(perspective, pieceSquare) ((((pieceSquare) / 384 != (perspective)) * 6 + (pieceSquare) / 64 % 6) * 64 + ((perspective) == WHITE ? ((pieceSquare) & 63) ^ 56 : (pieceSquare) & 63))
+
+// Functions that take the side to move as a parameter are only called with WHITE or BLACK written out, so every caller gets its own copy with the color folded away
+#if defined(__GNUC__) || defined(__clang__)
+#define popCount(set) __builtin_popcountll(set)
+#define lsb(set) __builtin_ctzll(set)
+#define SPECIALIZED static inline __attribute__((always_inline))
+#else
+int popCount(uint64_t set) { int count = 0; for (; set; set &= set - 1) ++count; return count; }
+int lsb(uint64_t set) { int square = 0; for (; !(set & 1); set >>= 1) ++square; return square; }
+#define SPECIALIZED static inline
+#endif
+
+// The network's kernels work on as many 16 bit lanes at once as the instruction set has, or one at a time without AVX2 and SSE4.1
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SIMD_LANES 16
+typedef __m256i Lanes;
+#define loadLanes(address) _mm256_loadu_si256((const __m256i *)(address))
+#define storeLanes(address, lanes) _mm256_storeu_si256((__m256i *)(address), (lanes))
+#define addLanes(first, second) _mm256_add_epi16((first), (second))
+#define subtractLanes(first, second) _mm256_sub_epi16((first), (second))
+#define clipLanes(lanes) _mm256_min_epi16(_mm256_max_epi16((lanes), _mm256_setzero_si256()), _mm256_set1_epi16(NETWORK_QA))
+#define multiplyAddLanes(sum, first, second) _mm256_add_epi32((sum), _mm256_madd_epi16((first), (second)))
+#define zeroLanes() _mm256_setzero_si256()
+#define sumLanes(lanes) sumQuarter(_mm_add_epi32(_mm256_castsi256_si128(lanes), _mm256_extracti128_si256((lanes), 1)))
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#define SIMD_LANES 8
+typedef __m128i Lanes;
+#define loadLanes(address) _mm_loadu_si128((const __m128i *)(address))
+#define storeLanes(address, lanes) _mm_storeu_si128((__m128i *)(address), (lanes))
+#define addLanes(first, second) _mm_add_epi16((first), (second))
+#define subtractLanes(first, second) _mm_sub_epi16((first), (second))
+#define clipLanes(lanes) _mm_min_epi16(_mm_max_epi16((lanes), _mm_setzero_si128()), _mm_set1_epi16(NETWORK_QA))
+#define multiplyAddLanes(sum, first, second) _mm_add_epi32((sum), _mm_madd_epi16((first), (second)))
+#define zeroLanes() _mm_setzero_si128()
+#define sumLanes(lanes) sumQuarter(lanes)
+#else
+#define SIMD_LANES 1
+typedef int32_t Lanes;
+#define loadLanes(address) ((Lanes)*(address))
+#define storeLanes(address, lanes) (*(address) = (int16_t)(lanes))
+#define addLanes(first, second) ((first) + (second))
+#define subtractLanes(first, second) ((first) - (second))
+#define clipLanes(lanes) ((lanes) < 0 ? 0 : (lanes) > NETWORK_QA ? NETWORK_QA : (lanes))
+#define multiplyAddLanes(sum, first, second) ((sum) + (first) * (second))
+#define zeroLanes() 0
+#define sumLanes(lanes) (lanes)
+#endif
+#if defined(__AVX2__) || defined(__SSE4_1__)
+static inline int sumQuarter(__m128i lanes) {
+    lanes = _mm_add_epi32(lanes, _mm_shuffle_epi32(lanes, 0x4E));
+    return _mm_cvtsi128_si32(_mm_add_epi32(lanes, _mm_shuffle_epi32(lanes, 0xB1)));
+}
+#endif
 
 typedef char (*Board)[BOARD_SIZE];
-typedef char Chunk[CHUNK_SIZE][MAX_MOVE_SIZE];
+typedef uint64_t Bitboard;
+typedef uint16_t Move; // Origin square in the lowest 6 bits, destination square in the next 6 and the MoveType in the top 4
 
 typedef enum {
     WHITE,
@@ -51,6 +193,7 @@ typedef enum {
     DRAWBY50MOVERULE,
     DRAWBYMATERIAL,
     STALEMATE,
+    DRAWBYBITBASE,
     LOSE
 } GameStatus;
 
@@ -63,111 +206,970 @@ typedef enum {
     PAWN = 'P'
 } PieceType;
 
+// Index of each piece type inside the bitboard sets, in the same order as PIECE_SYMBOLS
 typedef enum {
-    FINDPIECES,
-    ISLEGALMOVE
-} SearchType;
+    PAWNS,
+    KNIGHTS,
+    BISHOPS,
+    ROOKS,
+    QUEENS,
+    KINGS
+} PieceSet;
 
+// A promotion is PROMOTION combined with the PieceSet of the new piece
 typedef enum {
     NORMALMOVE,
     DOUBLEPAWNMOVE,
     ENPEASANT,
-    PROMOTION,
     CASTLESHORT,
     CASTLELONG,
     PLAYERDRAW,
-    RESIGN
+    RESIGN,
+    TAKEBACK,
+    PROMOTION = 8
 } MoveType;
 
-typedef struct {
-    short int row;
-    short int col;
-} Position;
+typedef enum {
+    WHITESHORT = 1,
+    WHITELONG = 2,
+    BLACKSHORT = 4,
+    BLACKLONG = 8
+} CastlingRight;
 
+// One set per color and piece type, indexed by square = row * BOARD_SIZE + col (a8 = 0, h1 = 63)
 typedef struct {
-    bool canCastleShort : 1;
-    bool canCastleLong  : 1;
-    unsigned short int row : 3;
-    unsigned short int col : 3;
-} KingPosition;
+    Bitboard pieces[2][6];
+    Bitboard occupancy[2];
+    Bitboard occupied;
+    unsigned char squares[64]; // Index into PIECE_SYMBOLS of the piece on every occupied square, left stale on empty ones
+} Bitboards;
 
+// Maps the blockers of a slider on one square to its slice of the attack table
 typedef struct {
-    unsigned char p1 : 4;
-    unsigned char p2 : 4;
-} PieceCouple;
+    Bitboard mask;
+    Bitboard magic;
+    Bitboard *attacks;
+    unsigned int shift;
+} Magic;
 
-typedef PieceCouple BoardPosition[BOARD_SIZE * BOARD_SIZE / 2];
+// Kept up to date by makeMove and unmakeMove from the pieces they move, once refreshEvaluation has set it up
+typedef struct {
+    int pieceSquare[2]; // Sum of the pieceSquareValues of every piece, with the king's middlegame and with its endgame table
+    int16_t accumulator[2][NETWORK_SIZE]; // Hidden layer of the network from white's and from black's point of view, only updated while a network is loaded
+} Evaluation;
 
+// The pieces a move puts on and takes off the board, each as its index into PIECE_SYMBOLS times 64 plus its square
 typedef struct {
-    MoveType type;
-    Position origin;
-    Position destination;
-    char pieceMoved;
-    bool captures;
-    char promotionPiece;
-} Move;
+    int added[2];
+    int removed[2];
+    int addedCount;
+    int removedCount;
+} PieceChanges;
 
+// Weights of a network with one input for every piece on every square, a hidden layer of NETWORK_SIZE neurons per side and one output
 typedef struct {
-    Chunk *log;
-    int chunkCount;
-    int moveCounter;
-} GameLog;
+    int16_t featureWeights[NETWORK_INPUTS][NETWORK_SIZE];
+    int16_t featureBiases[NETWORK_SIZE];
+    int16_t outputWeights[2][NETWORK_SIZE]; // For the hidden layer of the side to move, then for the other side's
+    int16_t outputBias; // Quantized by NETWORK_QA * NETWORK_QB like the sums of the output layer
+} Network;
 
 typedef struct {
-    Board board;
-    KingPosition whiteKing;
-    KingPosition blackKing;
+    Bitboards bitboards;
+    Evaluation evaluation;
+    unsigned char castlingRights;
+    unsigned char enPeasant; // Square a pawn can capture en peasant on, 0 if there is none
     GameStatus status;
     Move move;
-    BoardPosition positions[100];
+    uint64_t key;
+    Bitboard checkers;
+    Bitboard pinned; // Own pieces that may only move along the line through them and their king
+    uint64_t keyHistory[HISTORY_SIZE]; // Ring of the keys of every position, indexed by plyCount
+    unsigned short int plyCount;
     unsigned short int movesWithoutCaptures;
-    unsigned short int moveCounter;
+    unsigned short int moveCounter; // Twice the fullmove number, plus one while black is to move
 } GameState;
 
-Board initializeBoard(void);
+typedef struct {
+    Move moves[MAX_MOVES];
+    unsigned short int count;
+} MoveList;
+
+// The legal moves of one position and their sanKeys, kept until the position changes so every ply generates its moves once
+typedef struct {
+    uint64_t key;
+    MoveList list;
+    uint32_t sanKeys[MAX_MOVES];
+} LegalMoves;
+
+// Everything makeMove overwrites that can not be recovered from the move itself
+typedef struct {
+    Move move;
+    signed char captured; // Index into PIECE_SYMBOLS of the captured piece, -1 if there is none
+    unsigned char castlingRights;
+    unsigned char enPeasant;
+    unsigned short int movesWithoutCaptures;
+    uint64_t key;
+    Bitboard checkers;
+    Bitboard pinned;
+} Undo;
+
+typedef struct {
+    Move move;
+    Undo undo;
+} HistoryEntry;
+
+// Blocks of the game history are linked both ways, so taking moves back can step into the previous block and keep the emptied one for the next moves
+typedef struct Chunk {
+    HistoryEntry entries[CHUNK_SIZE];
+    struct Chunk *previous;
+    struct Chunk *next;
+} Chunk;
+
+// Every move of the game with its undo record, appended without ever moving older entries and only written out in algebraic notation once the game is over
+typedef struct {
+    GameState start;
+    Chunk *first;
+    Chunk *last; // Block holding the latest move
+    int count; // Entries used in the last block
+    int moveCount;
+} GameLog;
+
+typedef enum {
+    NOHIGHLIGHT,
+    MOVEHIGHLIGHT,
+    CHECKHIGHLIGHT
+} Highlight;
+
+// What a terminal that understands ANSI escape codes shows of the board, which stays on its first rows while the prompts scroll below it
+typedef struct {
+    bool isEnabled;
+    char pieces[BOARD_SIZE * BOARD_SIZE]; // 0 until the square is drawn
+    unsigned char highlights[BOARD_SIZE * BOARD_SIZE];
+} Renderer;
+
+typedef struct {
+    uint64_t check; // The key XORed with the data, so an entry torn by two threads writing at once fails the lookup
+    uint64_t data; // Node count in the upper 56 bits, depth in the lowest 8
+} PerftEntry;
+
+typedef struct {
+    PerftEntry *entries;
+    uint64_t mask;
+} PerftTable;
+
+// Shared by the threads of one perft run, which take the root moves one at a time
+typedef struct {
+    GameState root;
+    MoveList moves;
+    uint64_t counts[MAX_MOVES];
+    int depth;
+    int nextMove;
+    pthread_mutex_t lock;
+    PerftTable table;
+} PerftJob;
+
+typedef enum {
+    UPPERBOUND = 1,
+    LOWERBOUND = 2,
+    EXACTBOUND = 3
+} Bound;
+
+typedef struct {
+    uint64_t check; // The key XORed with the data, so an entry torn by two threads writing at once fails the lookup
+    uint64_t data; // Packed move, score, depth, bound and generation
+} TableEntry;
+
+// One cache line of entries that share the same index
+typedef struct {
+    TableEntry entries[CLUSTER_SIZE];
+} Cluster;
+
+typedef struct {
+    Cluster *clusters;
+    uint64_t mask;
+    unsigned char generation; // Increased by every search, so entries of earlier searches are replaced first
+} TranspositionTable;
+
+typedef struct {
+    int depth;
+    uint64_t nodes;
+    long moveTime; // Milliseconds
+} SearchLimits;
+
+typedef enum {
+    TABLEMOVE,
+    CAPTUREGENERATION,
+    GOODCAPTURES,
+    KILLERMOVES,
+    QUIETGENERATION,
+    QUIETMOVES,
+    BADCAPTURES,
+    EVASIONGENERATION,
+    EVASIONS,
+    NOMOREMOVES
+} PickerStage;
+
+// Hands out the moves of a position one at a time: the move from the table or the previous iteration, the captures and queen promotions
+// that do not lose material by MVV-LVA, the killers, the quiet moves by history and the losing captures and underpromotions last.
+// Every kind of move is only generated once the ones before it failed to cut the search off
+typedef struct {
+    PickerStage stage;
+    bool capturesOnly; // Stops after the good captures, for the quiescence search
+    Move tableMove;
+    Move killers[2];
+    int killerIndex;
+    const int (*history)[BOARD_SIZE * BOARD_SIZE];
+    MoveList moves; // The moves of the current stage, the ones from next on not handed out yet
+    int scores[MAX_MOVES];
+    int next;
+    Move badCaptures[MAX_MOVES];
+    int badCount;
+    int badNext;
+} MovePicker;
+
+// One per thread, the main thread having id 0
+typedef struct {
+    GameState state;
+    int id;
+    int threadCount;
+    bool verbose;
+    Move bestMove;
+    SearchLimits limits;
+    struct timespec start;
+    uint64_t nodes;
+    bool stopped;
+    bool followPV; // Whether every move on the way to this node was on the line of the previous iteration
+    int completedDepth;
+    Move killers[MAX_PLY][2]; // The last two quiet moves that caused a beta cutoff at every ply
+    int history[2][BOARD_SIZE * BOARD_SIZE][BOARD_SIZE * BOARD_SIZE]; // How well quiet moves of each side from one square to another did, by origin and destination
+    uint64_t cutoffs;
+    uint64_t firstMoveCutoffs; // Beta cutoffs by the first move searched, the share of which tells how good the move ordering is
+    Move pv[MAX_PLY][MAX_PLY]; // Row ply holds the best line found from that ply on
+    int pvLength[MAX_PLY];
+    Move previousPV[MAX_PLY];
+    int previousLength;
+} Search;
+
+// The position and limits of a search running on its own thread while the UCI input loop keeps reading
+typedef struct {
+    GameState position;
+    SearchLimits limits;
+    pthread_t thread;
+    bool isRunning;
+    bool isHeld; // Set by "go infinite" and "go ponder", the answer then waits for "stop" or "ponderhit"
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} SearchJob;
+
+typedef struct {
+    const char *fen;
+    uint64_t counts[PERFT_SUITE_DEPTH];
+} PerftPosition;
+
+// Growable text, used for the games of a batch and for the lines replaying them produced
+typedef struct {
+    char *text;
+    size_t length;
+    size_t capacity;
+} TextBuffer;
+
+// Consecutive games of one file, replayed by one worker so the queue is only locked once per batch
+typedef struct {
+    const char *fileName;
+    unsigned long firstGame;
+    int gameCount;
+    size_t offsets[PGN_BATCH_GAMES]; // Where each game starts inside games, every game ends with a '\0'
+    TextBuffer games;
+    TextBuffer output;
+    int illegalCount;
+    bool failed;
+    bool isDone;
+    // Only used when packing: the archive records of the batch and the parts of the game being replayed
+    bool isPacking;
+    int recordCount;
+    size_t recordOffsets[PGN_BATCH_GAMES];
+    TextBuffer records;
+    TextBuffer tags;
+    TextBuffer moves;
+    TextBuffer clocks;
+    TextBuffer evals;
+} PgnBatch;
+
+// A ring of batches: the reader fills them in input order, the workers replay them in any order and the reader prints them in input order again
+typedef struct {
+    PgnBatch batches[2 * MAX_THREADS];
+    int slotCount;
+    unsigned long filled;
+    unsigned long taken;
+    unsigned long printed;
+    unsigned long gameCount;
+    unsigned long illegalCount;
+    bool isFinished;
+    bool failed;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+    FILE *archive; // Receives the packed games instead of replaying them to stdout, NULL unless packing
+    uint64_t archiveSize;
+    TextBuffer index;
+} PgnQueue;
+
+// Whole lines of a mapped FEN or EPD file and the normalized lines they turned into
+typedef struct {
+    const char *begin;
+    const char *end;
+    TextBuffer output;
+    unsigned long positionCount;
+    unsigned long invalidCount;
+    bool failed;
+} FenSlice;
+
+// A mapped archive: the magic, the game records, the offset of every game, the game count and the index magic
+typedef struct {
+    const unsigned char *data;
+    size_t size;
+    const unsigned char *index;
+    uint64_t gameCount;
+} Archive;
+
+// One game of an archive, pointing into its mapping; see packGame for the layout of a record
+typedef struct {
+    const char *result;
+    const char *fen; // NULL if the game starts from the start position
+    int fenLength;
+    const unsigned char *tags; // Name and value of every other tag, each ending with a '\0'
+    int tagsLength;
+    int plyCount;
+    const unsigned char *moves;
+    const unsigned char *clocks; // NULL if the game has no clock times
+    const unsigned char *evals; // NULL if the game has no evaluations
+} ArchiveGame;
+
+// A mapped Polyglot book: entries of 16 bytes holding the key, the move, the weight and a learn value, big endian and sorted by key
+typedef struct {
+    const unsigned char *entries;
+    size_t count;
+    uint64_t seed; // Picks among the moves of a position by their weights
+} Book;
+
+// A move of a position in a book being built
+typedef struct {
+    uint64_t key;
+    uint16_t move;
+    uint32_t weight;
+} BookEntry;
+
+// Consecutive games of an archive replayed by one thread
+typedef struct {
+    const Archive *archive;
+    const char *fileName;
+    uint64_t first;
+    uint64_t last;
+    TextBuffer output;
+    unsigned long illegalCount;
+    bool failed;
+} ArchiveSlice;
+
+// What the side to move gets in a position of an ending. A built bitbase stores two bits per position, a win or a loss and 0 for a draw
+typedef enum {
+    UNRESOLVED,
+    BITBASEWIN,
+    BITBASELOSS,
+    BITBASEDRAW
+} BitbaseValue;
+
+// The positions of an ending of up to four pieces with either side to move, indexed as in bitbaseIndex
+typedef struct {
+    char name[8];
+    signed char pieces[2]; // PIECE_SYMBOLS indices of the pieces besides the kings, the stronger side is white and listed first; -1 if there is none
+    int pieceCount;
+    bool hasPawns;
+    uint64_t size;
+    const unsigned char *table; // Two bits per position holding a BitbaseValue, NULL until the ending is built or loaded
+    size_t mappedSize; // Size of the mapped file if the table was loaded from one
+    bool isBuilding;
+} Bitbase;
+
+// Shared by the threads building bitbases, which take any wanted ending once the endings its captures and promotions lead to are built
+typedef struct {
+    bool wanted[MAX_BITBASES];
+    const char *directory; // Every finished ending is saved there unless it is NULL
+    bool isQuiet; // Saves without reporting, for the endings built at startup
+    bool failed;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} BitbaseJob;
+
+Bitboard knightAttacks[BOARD_SIZE * BOARD_SIZE];
+Bitboard kingAttacks[BOARD_SIZE * BOARD_SIZE];
+Bitboard pawnAttacks[2][BOARD_SIZE * BOARD_SIZE];
+Bitboard betweenSquares[BOARD_SIZE * BOARD_SIZE][BOARD_SIZE * BOARD_SIZE];
+Bitboard lineThrough[BOARD_SIZE * BOARD_SIZE][BOARD_SIZE * BOARD_SIZE];
+Bitboard rookTable[0x19000];
+Bitboard bishopTable[0x1480];
+Magic rookMagics[BOARD_SIZE * BOARD_SIZE];
+Magic bishopMagics[BOARD_SIZE * BOARD_SIZE];
+uint64_t pieceKeys[12][BOARD_SIZE * BOARD_SIZE];
+uint64_t castlingKeys[16];
+uint64_t enPeasantKeys[BOARD_SIZE];
+uint64_t sideKey;
+// Hashes positions the way Polyglot books do: 64 keys per piece and square, then the castling rights, the en peasant files and white to move
+uint64_t polyglotKeys[POLYGLOT_KEY_COUNT];
+Book openingBook;
+Bitbase bitbases[MAX_BITBASES];
+int bitbaseCount;
+signed char bitbaseOf[36][36]; // Index into bitbases by the materialCode of the white and the black pieces, -1 if there is none
+TranspositionTable transpositionTable;
+Network *network; // NULL while the search uses the classical evaluation
+Search threadSearches[MAX_THREADS]; // Kept after the search, so runBench can read its counts
+int pieceSquareValues[2][12 * BOARD_SIZE * BOARD_SIZE]; // Material and piece-square value of every piece on every square from white's point of view, by king table
+int searchThreads = 1;
+volatile bool stopSearch; // Raised by the main search thread so the helpers finish, or by a UCI "stop"; reset by whoever starts a search
+// The castling rights lost when a piece moves from or to the square
+const unsigned char castlingLoss[BOARD_SIZE * BOARD_SIZE] = { [0] = BLACKLONG, [4] = BLACKSHORT | BLACKLONG, [7] = BLACKSHORT, [56] = WHITELONG, [60] = WHITESHORT | WHITELONG, [63] = WHITESHORT };
+const char *const results[4] = { "*", "1-0", "0-1", "1/2-1/2" };
+// Indexed by GameStatus
+const char *const statusNames[] = { "white-to-move", "black-to-move", "white-wins", "draw-agreed", "draw-repetition", "draw-50-moves", "draw-material", "stalemate", "draw-bitbase", "black-wins" };
+const int pieceValues[6] = { 100, 320, 330, 500, 900, 0 };
+// Bonus of each piece type on every square from white's point of view, the last table is used for the king once the queens are traded
+const short int pieceSquareTables[7][BOARD_SIZE * BOARD_SIZE] = {
+    {
+          0,   0,   0,   0,   0,   0,   0,   0,
+         50,  50,  50,  50,  50,  50,  50,  50,
+         10,  10,  20,  30,  30,  20,  10,  10,
+          5,   5,  10,  25,  25,  10,   5,   5,
+          0,   0,   0,  20,  20,   0,   0,   0,
+          5,  -5, -10,   0,   0, -10,  -5,   5,
+          5,  10,  10, -20, -20,  10,  10,   5,
+          0,   0,   0,   0,   0,   0,   0,   0
+    }, {
+        -50, -40, -30, -30, -30, -30, -40, -50,
+        -40, -20,   0,   0,   0,   0, -20, -40,
+        -30,   0,  10,  15,  15,  10,   0, -30,
+        -30,   5,  15,  20,  20,  15,   5, -30,
+        -30,   0,  15,  20,  20,  15,   0, -30,
+        -30,   5,  10,  15,  15,  10,   5, -30,
+        -40, -20,   0,   5,   5,   0, -20, -40,
+        -50, -40, -30, -30, -30, -30, -40, -50
+    }, {
+        -20, -10, -10, -10, -10, -10, -10, -20,
+        -10,   0,   0,   0,   0,   0,   0, -10,
+        -10,   0,   5,  10,  10,   5,   0, -10,
+        -10,   5,   5,  10,  10,   5,   5, -10,
+        -10,   0,  10,  10,  10,  10,   0, -10,
+        -10,  10,  10,  10,  10,  10,  10, -10,
+        -10,   5,   0,   0,   0,   0,   5, -10,
+        -20, -10, -10, -10, -10, -10, -10, -20
+    }, {
+          0,   0,   0,   0,   0,   0,   0,   0,
+          5,  10,  10,  10,  10,  10,  10,   5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+         -5,   0,   0,   0,   0,   0,   0,  -5,
+          0,   0,   0,   5,   5,   0,   0,   0
+    }, {
+        -20, -10, -10,  -5,  -5, -10, -10, -20,
+        -10,   0,   0,   0,   0,   0,   0, -10,
+        -10,   0,   5,   5,   5,   5,   0, -10,
+         -5,   0,   5,   5,   5,   5,   0,  -5,
+          0,   0,   5,   5,   5,   5,   0,  -5,
+        -10,   5,   5,   5,   5,   5,   0, -10,
+        -10,   0,   5,   0,   0,   0,   0, -10,
+        -20, -10, -10,  -5,  -5, -10, -10, -20
+    }, {
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -30, -40, -40, -50, -50, -40, -40, -30,
+        -20, -30, -30, -40, -40, -30, -30, -20,
+        -10, -20, -20, -20, -20, -20, -20, -10,
+         20,  20,   0,   0,   0,   0,  20,  20,
+         20,  30,  10,   0,   0,  10,  30,  20
+    }, {
+        -50, -40, -30, -20, -20, -30, -40, -50,
+        -30, -20, -10,   0,   0, -10, -20, -30,
+        -30, -10,  20,  30,  30,  20, -10, -30,
+        -30, -10,  30,  40,  40,  30, -10, -30,
+        -30, -10,  30,  40,  40,  30, -10, -30,
+        -30, -10,  20,  30,  30,  20, -10, -30,
+        -30, -30,   0,   0,   0,   0, -30, -30,
+        -50, -30, -30, -30, -30, -30, -30, -50
+    }
+};
+// Positions with known node counts that cover castling, en peasant, promotions and discovered checks
+const PerftPosition perftSuite[PERFT_SUITE_SIZE] = {
+    { "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1", { 20, 400, 8902, 197281, 4865609 } },
+    { "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1", { 48, 2039, 97862, 4085603, 193690690 } },
+    { "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1", { 14, 191, 2812, 43238, 674624 } },
+    { "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1", { 6, 264, 9467, 422333, 15833292 } },
+    { "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8", { 44, 1486, 62379, 2103487, 89941194 } },
+    { "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10", { 46, 2079, 89890, 3894594, 164075551 } }
+};
+// Well-formed FEN strings of positions that cannot arise in a game, which setPosition has to reject
+const char *const illegalSuite[ILLEGAL_SUITE_SIZE] = {
+    "k7/8/8/8/8/8/8/R6K w - - 0 1", // The king of the side not to move is in check
+    "4k3/8/8/8/8/8/8/4K2p b - - 0 1" // A pawn on the first rank
+};
+// Found by trying sparse random numbers until every blocker subset of the square maps to a slot without destructive collisions
+const Bitboard rookMagicNumbers[BOARD_SIZE * BOARD_SIZE] = {
+    0x1080004008801020ULL, 0x0840092002C03000ULL, 0x1900200010400900ULL, 0x0880100008000480ULL,
+    0x4200100420080200ULL, 0x8100020100080400ULL, 0x0200040110886200ULL, 0x0200008040220411ULL,
+    0x0404800084400220ULL, 0x0000401000402000ULL, 0x0086001081220440ULL, 0x0408800800100280ULL,
+    0x000A001201040820ULL, 0x8848800200840080ULL, 0x4001000100040200ULL, 0x0442000102105084ULL,
+    0x9080010020804100ULL, 0x0040404000201009ULL, 0x0000808010002009ULL, 0x2200090021D00100ULL,
+    0x0008008008040080ULL, 0x0004004002010040ULL, 0x0011040008015042ULL, 0x00000A0001768104ULL,
+    0x0000800080204009ULL, 0x2010004140002001ULL, 0x9800200280100080ULL, 0x1000100080080080ULL,
+    0x0442000A00049020ULL, 0x2100040080020080ULL, 0x0800120400900148ULL, 0x0010040A00128541ULL,
+    0x2800804000800030ULL, 0x1010002000400041ULL, 0x4000200011004100ULL, 0x0610008410800800ULL,
+    0x0400802402800800ULL, 0xC100020080800400ULL, 0x0002000802000401ULL, 0x0182085882000401ULL,
+    0x0220204000808000ULL, 0x2860100040024022ULL, 0x0001002004110040ULL, 0x99101042000A0020ULL,
+    0x0004080004008080ULL, 0x0010040002008080ULL, 0x2012004881020004ULL, 0x8300842444820011ULL,
+    0x0088403882010200ULL, 0x0820400080210100ULL, 0x0110910040A00300ULL, 0x0801100280080480ULL,
+    0x0242009008200600ULL, 0x1002000489500200ULL, 0x0040800200010080ULL, 0x0091800041000080ULL,
+    0x0000209300488001ULL, 0x04C1002414824001ULL, 0x020020000B001041ULL, 0x7000100004200901ULL,
+    0x8002002004100802ULL, 0x30010002084C0007ULL, 0x0888221800813004ULL, 0x4000002840840112ULL
+};
+const Bitboard bishopMagicNumbers[BOARD_SIZE * BOARD_SIZE] = {
+    0xA010041108003100ULL, 0x006082020A002900ULL, 0x6810010619200000ULL, 0x08281A0520000408ULL,
+    0x0001104001000400ULL, 0x0018901008048400ULL, 0x00040A0210245280ULL, 0x000200210808A402ULL,
+    0x9140048410821200ULL, 0x0800091010820041ULL, 0x20504804832202C0ULL, 0x0100091401081000ULL,
+    0x8021011140000012ULL, 0x0810020804450400ULL, 0x208B0542109008A2ULL, 0x0080084A08040204ULL,
+    0x0040E2A80811244CULL, 0x2505022008008108ULL, 0x0430220100420040ULL, 0x010A040420220040ULL,
+    0x1105000290400000ULL, 0x0093001200822120ULL, 0x4000A62048043004ULL, 0x280120048A015004ULL,
+    0x006090002A020814ULL, 0x44042000240800D0ULL, 0x01102800040A4400ULL, 0x1004080080220040ULL,
+    0x0001001011004024ULL, 0x0010044000805040ULL, 0x0914041200820100ULL, 0x0004821012821480ULL,
+    0x0024040500C05021ULL, 0x0088611002080200ULL, 0x0116080A00040020ULL, 0x4000020080080080ULL,
+    0x2450450140840040ULL, 0x0000880201484100ULL, 0x0222020404020092ULL, 0x8081110600002E00ULL,
+    0x2842101105000801ULL, 0x1100809008001025ULL, 0x00020202221C0400ULL, 0x0422014022009020ULL,
+    0x0210046102100C00ULL, 0xC004008082029102ULL, 0x00AA461801101200ULL, 0x0404080080201108ULL,
+    0x020542108C205002ULL, 0x0410544804100100ULL, 0x0040910841100000ULL, 0x0400200042021100ULL,
+    0x00004204850400C0ULL, 0x0200100410A42102ULL, 0x1040020801210102ULL, 0x0805040410420000ULL,
+    0x2884804130100200ULL, 0x800C262201242000ULL, 0x1058000194108800ULL, 0x0014221054420204ULL,
+    0x0104000012A02200ULL, 0x0200881003300100ULL, 0x0140400202840100ULL, 0x0402020801010201ULL
+};
+// The Random64 array of the Polyglot sources, which every standard Polyglot book is hashed with
+const uint64_t polyglotRandom[POLYGLOT_KEY_COUNT] = {
+    0x9D39247E33776D41ULL, 0x2AF7398005AAA5C7ULL, 0x44DB015024623547ULL, 0x9C15F73E62A76AE2ULL,
+    0x75834465489C0C89ULL, 0x3290AC3A203001BFULL, 0x0FBBAD1F61042279ULL, 0xE83A908FF2FB60CAULL,
+    0x0D7E765D58755C10ULL, 0x1A083822CEAFE02DULL, 0x9605D5F0E25EC3B0ULL, 0xD021FF5CD13A2ED5ULL,
+    0x40BDF15D4A672E32ULL, 0x011355146FD56395ULL, 0x5DB4832046F3D9E5ULL, 0x239F8B2D7FF719CCULL,
+    0x05D1A1AE85B49AA1ULL, 0x679F848F6E8FC971ULL, 0x7449BBFF801FED0BULL, 0x7D11CDB1C3B7ADF0ULL,
+    0x82C7709E781EB7CCULL, 0xF3218F1C9510786CULL, 0x331478F3AF51BBE6ULL, 0x4BB38DE5E7219443ULL,
+    0xAA649C6EBCFD50FCULL, 0x8DBD98A352AFD40BULL, 0x87D2074B81D79217ULL, 0x19F3C751D3E92AE1ULL,
+    0xB4AB30F062B19ABFULL, 0x7B0500AC42047AC4ULL, 0xC9452CA81A09D85DULL, 0x24AA6C514DA27500ULL,
+    0x4C9F34427501B447ULL, 0x14A68FD73C910841ULL, 0xA71B9B83461CBD93ULL, 0x03488B95B0F1850FULL,
+    0x637B2B34FF93C040ULL, 0x09D1BC9A3DD90A94ULL, 0x3575668334A1DD3BULL, 0x735E2B97A4C45A23ULL,
+    0x18727070F1BD400BULL, 0x1FCBACD259BF02E7ULL, 0xD310A7C2CE9B6555ULL, 0xBF983FE0FE5D8244ULL,
+    0x9F74D14F7454A824ULL, 0x51EBDC4AB9BA3035ULL, 0x5C82C505DB9AB0FAULL, 0xFCF7FE8A3430B241ULL,
+    0x3253A729B9BA3DDEULL, 0x8C74C368081B3075ULL, 0xB9BC6C87167C33E7ULL, 0x7EF48F2B83024E20ULL,
+    0x11D505D4C351BD7FULL, 0x6568FCA92C76A243ULL, 0x4DE0B0F40F32A7B8ULL, 0x96D693460CC37E5DULL,
+    0x42E240CB63689F2FULL, 0x6D2BDCDAE2919661ULL, 0x42880B0236E4D951ULL, 0x5F0F4A5898171BB6ULL,
+    0x39F890F579F92F88ULL, 0x93C5B5F47356388BULL, 0x63DC359D8D231B78ULL, 0xEC16CA8AEA98AD76ULL,
+    0x5355F900C2A82DC7ULL, 0x07FB9F855A997142ULL, 0x5093417AA8A7ED5EULL, 0x7BCBC38DA25A7F3CULL,
+    0x19FC8A768CF4B6D4ULL, 0x637A7780DECFC0D9ULL, 0x8249A47AEE0E41F7ULL, 0x79AD695501E7D1E8ULL,
+    0x14ACBAF4777D5776ULL, 0xF145B6BECCDEA195ULL, 0xDABF2AC8201752FCULL, 0x24C3C94DF9C8D3F6ULL,
+    0xBB6E2924F03912EAULL, 0x0CE26C0B95C980D9ULL, 0xA49CD132BFBF7CC4ULL, 0xE99D662AF4243939ULL,
+    0x27E6AD7891165C3FULL, 0x8535F040B9744FF1ULL, 0x54B3F4FA5F40D873ULL, 0x72B12C32127FED2BULL,
+    0xEE954D3C7B411F47ULL, 0x9A85AC909A24EAA1ULL, 0x70AC4CD9F04F21F5ULL, 0xF9B89D3E99A075C2ULL,
+    0x87B3E2B2B5C907B1ULL, 0xA366E5B8C54F48B8ULL, 0xAE4A9346CC3F7CF2ULL, 0x1920C04D47267BBDULL,
+    0x87BF02C6B49E2AE9ULL, 0x092237AC237F3859ULL, 0xFF07F64EF8ED14D0ULL, 0x8DE8DCA9F03CC54EULL,
+    0x9C1633264DB49C89ULL, 0xB3F22C3D0B0B38EDULL, 0x390E5FB44D01144BULL, 0x5BFEA5B4712768E9ULL,
+    0x1E1032911FA78984ULL, 0x9A74ACB964E78CB3ULL, 0x4F80F7A035DAFB04ULL, 0x6304D09A0B3738C4ULL,
+    0x2171E64683023A08ULL, 0x5B9B63EB9CEFF80CULL, 0x506AACF489889342ULL, 0x1881AFC9A3A701D6ULL,
+    0x6503080440750644ULL, 0xDFD395339CDBF4A7ULL, 0xEF927DBCF00C20F2ULL, 0x7B32F7D1E03680ECULL,
+    0xB9FD7620E7316243ULL, 0x05A7E8A57DB91B77ULL, 0xB5889C6E15630A75ULL, 0x4A750A09CE9573F7ULL,
+    0xCF464CEC899A2F8AULL, 0xF538639CE705B824ULL, 0x3C79A0FF5580EF7FULL, 0xEDE6C87F8477609DULL,
+    0x799E81F05BC93F31ULL, 0x86536B8CF3428A8CULL, 0x97D7374C60087B73ULL, 0xA246637CFF328532ULL,
+    0x043FCAE60CC0EBA0ULL, 0x920E449535DD359EULL, 0x70EB093B15B290CCULL, 0x73A1921916591CBDULL,
+    0x56436C9FE1A1AA8DULL, 0xEFAC4B70633B8F81ULL, 0xBB215798D45DF7AFULL, 0x45F20042F24F1768ULL,
+    0x930F80F4E8EB7462ULL, 0xFF6712FFCFD75EA1ULL, 0xAE623FD67468AA70ULL, 0xDD2C5BC84BC8D8FCULL,
+    0x7EED120D54CF2DD9ULL, 0x22FE545401165F1CULL, 0xC91800E98FB99929ULL, 0x808BD68E6AC10365ULL,
+    0xDEC468145B7605F6ULL, 0x1BEDE3A3AEF53302ULL, 0x43539603D6C55602ULL, 0xAA969B5C691CCB7AULL,
+    0xA87832D392EFEE56ULL, 0x65942C7B3C7E11AEULL, 0xDED2D633CAD004F6ULL, 0x21F08570F420E565ULL,
+    0xB415938D7DA94E3CULL, 0x91B859E59ECB6350ULL, 0x10CFF333E0ED804AULL, 0x28AED140BE0BB7DDULL,
+    0xC5CC1D89724FA456ULL, 0x5648F680F11A2741ULL, 0x2D255069F0B7DAB3ULL, 0x9BC5A38EF729ABD4ULL,
+    0xEF2F054308F6A2BCULL, 0xAF2042F5CC5C2858ULL, 0x480412BAB7F5BE2AULL, 0xAEF3AF4A563DFE43ULL,
+    0x19AFE59AE451497FULL, 0x52593803DFF1E840ULL, 0xF4F076E65F2CE6F0ULL, 0x11379625747D5AF3ULL,
+    0xBCE5D2248682C115ULL, 0x9DA4243DE836994FULL, 0x066F70B33FE09017ULL, 0x4DC4DE189B671A1CULL,
+    0x51039AB7712457C3ULL, 0xC07A3F80C31FB4B4ULL, 0xB46EE9C5E64A6E7CULL, 0xB3819A42ABE61C87ULL,
+    0x21A007933A522A20ULL, 0x2DF16F761598AA4FULL, 0x763C4A1371B368FDULL, 0xF793C46702E086A0ULL,
+    0xD7288E012AEB8D31ULL, 0xDE336A2A4BC1C44BULL, 0x0BF692B38D079F23ULL, 0x2C604A7A177326B3ULL,
+    0x4850E73E03EB6064ULL, 0xCFC447F1E53C8E1BULL, 0xB05CA3F564268D99ULL, 0x9AE182C8BC9474E8ULL,
+    0xA4FC4BD4FC5558CAULL, 0xE755178D58FC4E76ULL, 0x69B97DB1A4C03DFEULL, 0xF9B5B7C4ACC67C96ULL,
+    0xFC6A82D64B8655FBULL, 0x9C684CB6C4D24417ULL, 0x8EC97D2917456ED0ULL, 0x6703DF9D2924E97EULL,
+    0xC547F57E42A7444EULL, 0x78E37644E7CAD29EULL, 0xFE9A44E9362F05FAULL, 0x08BD35CC38336615ULL,
+    0x9315E5EB3A129ACEULL, 0x94061B871E04DF75ULL, 0xDF1D9F9D784BA010ULL, 0x3BBA57B68871B59DULL,
+    0xD2B7ADEEDED1F73FULL, 0xF7A255D83BC373F8ULL, 0xD7F4F2448C0CEB81ULL, 0xD95BE88CD210FFA7ULL,
+    0x336F52F8FF4728E7ULL, 0xA74049DAC312AC71ULL, 0xA2F61BB6E437FDB5ULL, 0x4F2A5CB07F6A35B3ULL,
+    0x87D380BDA5BF7859ULL, 0x16B9F7E06C453A21ULL, 0x7BA2484C8A0FD54EULL, 0xF3A678CAD9A2E38CULL,
+    0x39B0BF7DDE437BA2ULL, 0xFCAF55C1BF8A4424ULL, 0x18FCF680573FA594ULL, 0x4C0563B89F495AC3ULL,
+    0x40E087931A00930DULL, 0x8CFFA9412EB642C1ULL, 0x68CA39053261169FULL, 0x7A1EE967D27579E2ULL,
+    0x9D1D60E5076F5B6FULL, 0x3810E399B6F65BA2ULL, 0x32095B6D4AB5F9B1ULL, 0x35CAB62109DD038AULL,
+    0xA90B24499FCFAFB1ULL, 0x77A225A07CC2C6BDULL, 0x513E5E634C70E331ULL, 0x4361C0CA3F692F12ULL,
+    0xD941ACA44B20A45BULL, 0x528F7C8602C5807BULL, 0x52AB92BEB9613989ULL, 0x9D1DFA2EFC557F73ULL,
+    0x722FF175F572C348ULL, 0x1D1260A51107FE97ULL, 0x7A249A57EC0C9BA2ULL, 0x04208FE9E8F7F2D6ULL,
+    0x5A110C6058B920A0ULL, 0x0CD9A497658A5698ULL, 0x56FD23C8F9715A4CULL, 0x284C847B9D887AAEULL,
+    0x04FEABFBBDB619CBULL, 0x742E1E651C60BA83ULL, 0x9A9632E65904AD3CULL, 0x881B82A13B51B9E2ULL,
+    0x506E6744CD974924ULL, 0xB0183DB56FFC6A79ULL, 0x0ED9B915C66ED37EULL, 0x5E11E86D5873D484ULL,
+    0xF678647E3519AC6EULL, 0x1B85D488D0F20CC5ULL, 0xDAB9FE6525D89021ULL, 0x0D151D86ADB73615ULL,
+    0xA865A54EDCC0F019ULL, 0x93C42566AEF98FFBULL, 0x99E7AFEABE000731ULL, 0x48CBFF086DDF285AULL,
+    0x7F9B6AF1EBF78BAFULL, 0x58627E1A149BBA21ULL, 0x2CD16E2ABD791E33ULL, 0xD363EFF5F0977996ULL,
+    0x0CE2A38C344A6EEDULL, 0x1A804AADB9CFA741ULL, 0x907F30421D78C5DEULL, 0x501F65EDB3034D07ULL,
+    0x37624AE5A48FA6E9ULL, 0x957BAF61700CFF4EULL, 0x3A6C27934E31188AULL, 0xD49503536ABCA345ULL,
+    0x088E049589C432E0ULL, 0xF943AEE7FEBF21B8ULL, 0x6C3B8E3E336139D3ULL, 0x364F6FFA464EE52EULL,
+    0xD60F6DCEDC314222ULL, 0x56963B0DCA418FC0ULL, 0x16F50EDF91E513AFULL, 0xEF1955914B609F93ULL,
+    0x565601C0364E3228ULL, 0xECB53939887E8175ULL, 0xBAC7A9A18531294BULL, 0xB344C470397BBA52ULL,
+    0x65D34954DAF3CEBDULL, 0xB4B81B3FA97511E2ULL, 0xB422061193D6F6A7ULL, 0x071582401C38434DULL,
+    0x7A13F18BBEDC4FF5ULL, 0xBC4097B116C524D2ULL, 0x59B97885E2F2EA28ULL, 0x99170A5DC3115544ULL,
+    0x6F423357E7C6A9F9ULL, 0x325928EE6E6F8794ULL, 0xD0E4366228B03343ULL, 0x565C31F7DE89EA27ULL,
+    0x30F5611484119414ULL, 0xD873DB391292ED4FULL, 0x7BD94E1D8E17DEBCULL, 0xC7D9F16864A76E94ULL,
+    0x947AE053EE56E63CULL, 0xC8C93882F9475F5FULL, 0x3A9BF55BA91F81CAULL, 0xD9A11FBB3D9808E4ULL,
+    0x0FD22063EDC29FCAULL, 0xB3F256D8ACA0B0B9ULL, 0xB03031A8B4516E84ULL, 0x35DD37D5871448AFULL,
+    0xE9F6082B05542E4EULL, 0xEBFAFA33D7254B59ULL, 0x9255ABB50D532280ULL, 0xB9AB4CE57F2D34F3ULL,
+    0x693501D628297551ULL, 0xC62C58F97DD949BFULL, 0xCD454F8F19C5126AULL, 0xBBE83F4ECC2BDECBULL,
+    0xDC842B7E2819E230ULL, 0xBA89142E007503B8ULL, 0xA3BC941D0A5061CBULL, 0xE9F6760E32CD8021ULL,
+    0x09C7E552BC76492FULL, 0x852F54934DA55CC9ULL, 0x8107FCCF064FCF56ULL, 0x098954D51FFF6580ULL,
+    0x23B70EDB1955C4BFULL, 0xC330DE426430F69DULL, 0x4715ED43E8A45C0AULL, 0xA8D7E4DAB780A08DULL,
+    0x0572B974F03CE0BBULL, 0xB57D2E985E1419C7ULL, 0xE8D9ECBE2CF3D73FULL, 0x2FE4B17170E59750ULL,
+    0x11317BA87905E790ULL, 0x7FBF21EC8A1F45ECULL, 0x1725CABFCB045B00ULL, 0x964E915CD5E2B207ULL,
+    0x3E2B8BCBF016D66DULL, 0xBE7444E39328A0ACULL, 0xF85B2B4FBCDE44B7ULL, 0x49353FEA39BA63B1ULL,
+    0x1DD01AAFCD53486AULL, 0x1FCA8A92FD719F85ULL, 0xFC7C95D827357AFAULL, 0x18A6A990C8B35EBDULL,
+    0xCCCB7005C6B9C28DULL, 0x3BDBB92C43B17F26ULL, 0xAA70B5B4F89695A2ULL, 0xE94C39A54A98307FULL,
+    0xB7A0B174CFF6F36EULL, 0xD4DBA84729AF48ADULL, 0x2E18BC1AD9704A68ULL, 0x2DE0966DAF2F8B1CULL,
+    0xB9C11D5B1E43A07EULL, 0x64972D68DEE33360ULL, 0x94628D38D0C20584ULL, 0xDBC0D2B6AB90A559ULL,
+    0xD2733C4335C6A72FULL, 0x7E75D99D94A70F4DULL, 0x6CED1983376FA72BULL, 0x97FCAACBF030BC24ULL,
+    0x7B77497B32503B12ULL, 0x8547EDDFB81CCB94ULL, 0x79999CDFF70902CBULL, 0xCFFE1939438E9B24ULL,
+    0x829626E3892D95D7ULL, 0x92FAE24291F2B3F1ULL, 0x63E22C147B9C3403ULL, 0xC678B6D860284A1CULL,
+    0x5873888850659AE7ULL, 0x0981DCD296A8736DULL, 0x9F65789A6509A440ULL, 0x9FF38FED72E9052FULL,
+    0xE479EE5B9930578CULL, 0xE7F28ECD2D49EECDULL, 0x56C074A581EA17FEULL, 0x5544F7D774B14AEFULL,
+    0x7B3F0195FC6F290FULL, 0x12153635B2C0CF57ULL, 0x7F5126DBBA5E0CA7ULL, 0x7A76956C3EAFB413ULL,
+    0x3D5774A11D31AB39ULL, 0x8A1B083821F40CB4ULL, 0x7B4A38E32537DF62ULL, 0x950113646D1D6E03ULL,
+    0x4DA8979A0041E8A9ULL, 0x3BC36E078F7515D7ULL, 0x5D0A12F27AD310D1ULL, 0x7F9D1A2E1EBE1327ULL,
+    0xDA3A361B1C5157B1ULL, 0xDCDD7D20903D0C25ULL, 0x36833336D068F707ULL, 0xCE68341F79893389ULL,
+    0xAB9090168DD05F34ULL, 0x43954B3252DC25E5ULL, 0xB438C2B67F98E5E9ULL, 0x10DCD78E3851A492ULL,
+    0xDBC27AB5447822BFULL, 0x9B3CDB65F82CA382ULL, 0xB67B7896167B4C84ULL, 0xBFCED1B0048EAC50ULL,
+    0xA9119B60369FFEBDULL, 0x1FFF7AC80904BF45ULL, 0xAC12FB171817EEE7ULL, 0xAF08DA9177DDA93DULL,
+    0x1B0CAB936E65C744ULL, 0xB559EB1D04E5E932ULL, 0xC37B45B3F8D6F2BAULL, 0xC3A9DC228CAAC9E9ULL,
+    0xF3B8B6675A6507FFULL, 0x9FC477DE4ED681DAULL, 0x67378D8ECCEF96CBULL, 0x6DD856D94D259236ULL,
+    0xA319CE15B0B4DB31ULL, 0x073973751F12DD5EULL, 0x8A8E849EB32781A5ULL, 0xE1925C71285279F5ULL,
+    0x74C04BF1790C0EFEULL, 0x4DDA48153C94938AULL, 0x9D266D6A1CC0542CULL, 0x7440FB816508C4FEULL,
+    0x13328503DF48229FULL, 0xD6BF7BAEE43CAC40ULL, 0x4838D65F6EF6748FULL, 0x1E152328F3318DEAULL,
+    0x8F8419A348F296BFULL, 0x72C8834A5957B511ULL, 0xD7A023A73260B45CULL, 0x94EBC8ABCFB56DAEULL,
+    0x9FC10D0F989993E0ULL, 0xDE68A2355B93CAE6ULL, 0xA44CFE79AE538BBEULL, 0x9D1D84FCCE371425ULL,
+    0x51D2B1AB2DDFB636ULL, 0x2FD7E4B9E72CD38CULL, 0x65CA5B96B7552210ULL, 0xDD69A0D8AB3B546DULL,
+    0x604D51B25FBF70E2ULL, 0x73AA8A564FB7AC9EULL, 0x1A8C1E992B941148ULL, 0xAAC40A2703D9BEA0ULL,
+    0x764DBEAE7FA4F3A6ULL, 0x1E99B96E70A9BE8BULL, 0x2C5E9DEB57EF4743ULL, 0x3A938FEE32D29981ULL,
+    0x26E6DB8FFDF5ADFEULL, 0x469356C504EC9F9DULL, 0xC8763C5B08D1908CULL, 0x3F6C6AF859D80055ULL,
+    0x7F7CC39420A3A545ULL, 0x9BFB227EBDF4C5CEULL, 0x89039D79D6FC5C5CULL, 0x8FE88B57305E2AB6ULL,
+    0xA09E8C8C35AB96DEULL, 0xFA7E393983325753ULL, 0xD6B6D0ECC617C699ULL, 0xDFEA21EA9E7557E3ULL,
+    0xB67C1FA481680AF8ULL, 0xCA1E3785A9E724E5ULL, 0x1CFC8BED0D681639ULL, 0xD18D8549D140CAEAULL,
+    0x4ED0FE7E9DC91335ULL, 0xE4DBF0634473F5D2ULL, 0x1761F93A44D5AEFEULL, 0x53898E4C3910DA55ULL,
+    0x734DE8181F6EC39AULL, 0x2680B122BAA28D97ULL, 0x298AF231C85BAFABULL, 0x7983EED3740847D5ULL,
+    0x66C1A2A1A60CD889ULL, 0x9E17E49642A3E4C1ULL, 0xEDB454E7BADC0805ULL, 0x50B704CAB602C329ULL,
+    0x4CC317FB9CDDD023ULL, 0x66B4835D9EAFEA22ULL, 0x219B97E26FFC81BDULL, 0x261E4E4C0A333A9DULL,
+    0x1FE2CCA76517DB90ULL, 0xD7504DFA8816EDBBULL, 0xB9571FA04DC089C8ULL, 0x1DDC0325259B27DEULL,
+    0xCF3F4688801EB9AAULL, 0xF4F5D05C10CAB243ULL, 0x38B6525C21A42B0EULL, 0x36F60E2BA4FA6800ULL,
+    0xEB3593803173E0CEULL, 0x9C4CD6257C5A3603ULL, 0xAF0C317D32ADAA8AULL, 0x258E5A80C7204C4BULL,
+    0x8B889D624D44885DULL, 0xF4D14597E660F855ULL, 0xD4347F66EC8941C3ULL, 0xE699ED85B0DFB40DULL,
+    0x2472F6207C2D0484ULL, 0xC2A1E7B5B459AEB5ULL, 0xAB4F6451CC1D45ECULL, 0x63767572AE3D6174ULL,
+    0xA59E0BD101731A28ULL, 0x116D0016CB948F09ULL, 0x2CF9C8CA052F6E9FULL, 0x0B090A7560A968E3ULL,
+    0xABEEDDB2DDE06FF1ULL, 0x58EFC10B06A2068DULL, 0xC6E57A78FBD986E0ULL, 0x2EAB8CA63CE802D7ULL,
+    0x14A195640116F336ULL, 0x7C0828DD624EC390ULL, 0xD74BBE77E6116AC7ULL, 0x804456AF10F5FB53ULL,
+    0xEBE9EA2ADF4321C7ULL, 0x03219A39EE587A30ULL, 0x49787FEF17AF9924ULL, 0xA1E9300CD8520548ULL,
+    0x5B45E522E4B1B4EFULL, 0xB49C3B3995091A36ULL, 0xD4490AD526F14431ULL, 0x12A8F216AF9418C2ULL,
+    0x001F837CC7350524ULL, 0x1877B51E57A764D5ULL, 0xA2853B80F17F58EEULL, 0x993E1DE72D36D310ULL,
+    0xB3598080CE64A656ULL, 0x252F59CF0D9F04BBULL, 0xD23C8E176D113600ULL, 0x1BDA0492E7E4586EULL,
+    0x21E0BD5026C619BFULL, 0x3B097ADAF088F94EULL, 0x8D14DEDB30BE846EULL, 0xF95CFFA23AF5F6F4ULL,
+    0x3871700761B3F743ULL, 0xCA672B91E9E4FA16ULL, 0x64C8E531BFF53B55ULL, 0x241260ED4AD1E87DULL,
+    0x106C09B972D2E822ULL, 0x7FBA195410E5CA30ULL, 0x7884D9BC6CB569D8ULL, 0x0647DFEDCD894A29ULL,
+    0x63573FF03E224774ULL, 0x4FC8E9560F91B123ULL, 0x1DB956E450275779ULL, 0xB8D91274B9E9D4FBULL,
+    0xA2EBEE47E2FBFCE1ULL, 0xD9F1F30CCD97FB09ULL, 0xEFED53D75FD64E6BULL, 0x2E6D02C36017F67FULL,
+    0xA9AA4D20DB084E9BULL, 0xB64BE8D8B25396C1ULL, 0x70CB6AF7C2D5BCF0ULL, 0x98F076A4F7A2322EULL,
+    0xBF84470805E69B5FULL, 0x94C3251F06F90CF3ULL, 0x3E003E616A6591E9ULL, 0xB925A6CD0421AFF3ULL,
+    0x61BDD1307C66E300ULL, 0xBF8D5108E27E0D48ULL, 0x240AB57A8B888B20ULL, 0xFC87614BAF287E07ULL,
+    0xEF02CDD06FFDB432ULL, 0xA1082C0466DF6C0AULL, 0x8215E577001332C8ULL, 0xD39BB9C3A48DB6CFULL,
+    0x2738259634305C14ULL, 0x61CF4F94C97DF93DULL, 0x1B6BACA2AE4E125BULL, 0x758F450C88572E0BULL,
+    0x959F587D507A8359ULL, 0xB063E962E045F54DULL, 0x60E8ED72C0DFF5D1ULL, 0x7B64978555326F9FULL,
+    0xFD080D236DA814BAULL, 0x8C90FD9B083F4558ULL, 0x106F72FE81E2C590ULL, 0x7976033A39F7D952ULL,
+    0xA4EC0132764CA04BULL, 0x733EA705FAE4FA77ULL, 0xB4D8F77BC3E56167ULL, 0x9E21F4F903B33FD9ULL,
+    0x9D765E419FB69F6DULL, 0xD30C088BA61EA5EFULL, 0x5D94337FBFAF7F5BULL, 0x1A4E4822EB4D7A59ULL,
+    0x6FFE73E81B637FB3ULL, 0xDDF957BC36D8B9CAULL, 0x64D0E29EEA8838B3ULL, 0x08DD9BDFD96B9F63ULL,
+    0x087E79E5A57D1D13ULL, 0xE328E230E3E2B3FBULL, 0x1C2559E30F0946BEULL, 0x720BF5F26F4D2EAAULL,
+    0xB0774D261CC609DBULL, 0x443F64EC5A371195ULL, 0x4112CF68649A260EULL, 0xD813F2FAB7F5C5CAULL,
+    0x660D3257380841EEULL, 0x59AC2C7873F910A3ULL, 0xE846963877671A17ULL, 0x93B633ABFA3469F8ULL,
+    0xC0C0F5A60EF4CDCFULL, 0xCAF21ECD4377B28CULL, 0x57277707199B8175ULL, 0x506C11B9D90E8B1DULL,
+    0xD83CC2687A19255FULL, 0x4A29C6465A314CD1ULL, 0xED2DF21216235097ULL, 0xB5635C95FF7296E2ULL,
+    0x22AF003AB672E811ULL, 0x52E762596BF68235ULL, 0x9AEBA33AC6ECC6B0ULL, 0x944F6DE09134DFB6ULL,
+    0x6C47BEC883A7DE39ULL, 0x6AD047C430A12104ULL, 0xA5B1CFDBA0AB4067ULL, 0x7C45D833AFF07862ULL,
+    0x5092EF950A16DA0BULL, 0x9338E69C052B8E7BULL, 0x455A4B4CFE30E3F5ULL, 0x6B02E63195AD0CF8ULL,
+    0x6B17B224BAD6BF27ULL, 0xD1E0CCD25BB9C169ULL, 0xDE0C89A556B9AE70ULL, 0x50065E535A213CF6ULL,
+    0x9C1169FA2777B874ULL, 0x78EDEFD694AF1EEDULL, 0x6DC93D9526A50E68ULL, 0xEE97F453F06791EDULL,
+    0x32AB0EDB696703D3ULL, 0x3A6853C7E70757A7ULL, 0x31865CED6120F37DULL, 0x67FEF95D92607890ULL,
+    0x1F2B1D1F15F6DC9CULL, 0xB69E38A8965C6B65ULL, 0xAA9119FF184CCCF4ULL, 0xF43C732873F24C13ULL,
+    0xFB4A3D794A9A80D2ULL, 0x3550C2321FD6109CULL, 0x371F77E76BB8417EULL, 0x6BFA9AAE5EC05779ULL,
+    0xCD04F3FF001A4778ULL, 0xE3273522064480CAULL, 0x9F91508BFFCFC14AULL, 0x049A7F41061A9E60ULL,
+    0xFCB6BE43A9F2FE9BULL, 0x08DE8A1C7797DA9BULL, 0x8F9887E6078735A1ULL, 0xB5B4071DBFC73A66ULL,
+    0x230E343DFBA08D33ULL, 0x43ED7F5A0FAE657DULL, 0x3A88A0FBBCB05C63ULL, 0x21874B8B4D2DBC4FULL,
+    0x1BDEA12E35F6A8C9ULL, 0x53C065C6C8E63528ULL, 0xE34A1D250E7A8D6BULL, 0xD6B04D3B7651DD7EULL,
+    0x5E90277E7CB39E2DULL, 0x2C046F22062DC67DULL, 0xB10BB459132D0A26ULL, 0x3FA9DDFB67E2F199ULL,
+    0x0E09B88E1914F7AFULL, 0x10E8B35AF3EEAB37ULL, 0x9EEDECA8E272B933ULL, 0xD4C718BC4AE8AE5FULL,
+    0x81536D601170FC20ULL, 0x91B534F885818A06ULL, 0xEC8177F83F900978ULL, 0x190E714FADA5156EULL,
+    0xB592BF39B0364963ULL, 0x89C350C893AE7DC1ULL, 0xAC042E70F8B383F2ULL, 0xB49B52E587A1EE60ULL,
+    0xFB152FE3FF26DA89ULL, 0x3E666E6F69AE2C15ULL, 0x3B544EBE544C19F9ULL, 0xE805A1E290CF2456ULL,
+    0x24B33C9D7ED25117ULL, 0xE74733427B72F0C1ULL, 0x0A804D18B7097475ULL, 0x57E3306D881EDB4FULL,
+    0x4AE7D6A36EB5DBCBULL, 0x2D8D5432157064C8ULL, 0xD1E649DE1E7F268BULL, 0x8A328A1CEDFE552CULL,
+    0x07A3AEC79624C7DAULL, 0x84547DDC3E203C94ULL, 0x990A98FD5071D263ULL, 0x1A4FF12616EEFC89ULL,
+    0xF6F7FD1431714200ULL, 0x30C05B1BA332F41CULL, 0x8D2636B81555A786ULL, 0x46C9FEB55D120902ULL,
+    0xCCEC0A73B49C9921ULL, 0x4E9D2827355FC492ULL, 0x19EBB029435DCB0FULL, 0x4659D2B743848A2CULL,
+    0x963EF2C96B33BE31ULL, 0x74F85198B05A2E7DULL, 0x5A0F544DD2B1FB18ULL, 0x03727073C2E134B1ULL,
+    0xC7F6AA2DE59AEA61ULL, 0x352787BAA0D7C22FULL, 0x9853EAB63B5E0B35ULL, 0xABBDCDD7ED5C0860ULL,
+    0xCF05DAF5AC8D77B0ULL, 0x49CAD48CEBF4A71EULL, 0x7A4C10EC2158C4A6ULL, 0xD9E92AA246BF719EULL,
+    0x13AE978D09FE5557ULL, 0x730499AF921549FFULL, 0x4E4B705B92903BA4ULL, 0xFF577222C14F0A3AULL,
+    0x55B6344CF97AAFAEULL, 0xB862225B055B6960ULL, 0xCAC09AFBDDD2CDB4ULL, 0xDAF8E9829FE96B5FULL,
+    0xB5FDFC5D3132C498ULL, 0x310CB380DB6F7503ULL, 0xE87FBB46217A360EULL, 0x2102AE466EBB1148ULL,
+    0xF8549E1A3AA5E00DULL, 0x07A69AFDCC42261AULL, 0xC4C118BFE78FEAAEULL, 0xF9F4892ED96BD438ULL,
+    0x1AF3DBE25D8F45DAULL, 0xF5B4B0B0D2DEEEB4ULL, 0x962ACEEFA82E1C84ULL, 0x046E3ECAAF453CE9ULL,
+    0xF05D129681949A4CULL, 0x964781CE734B3C84ULL, 0x9C2ED44081CE5FBDULL, 0x522E23F3925E319EULL,
+    0x177E00F9FC32F791ULL, 0x2BC60A63A6F3B3F2ULL, 0x222BBFAE61725606ULL, 0x486289DDCC3D6780ULL,
+    0x7DC7785B8EFDFC80ULL, 0x8AF38731C02BA980ULL, 0x1FAB64EA29A2DDF7ULL, 0xE4D9429322CD065AULL,
+    0x9DA058C67844F20CULL, 0x24C0E332B70019B0ULL, 0x233003B5A6CFE6ADULL, 0xD586BD01C5C217F6ULL,
+    0x5E5637885F29BC2BULL, 0x7EBA726D8C94094BULL, 0x0A56A5F0BFE39272ULL, 0xD79476A84EE20D06ULL,
+    0x9E4C1269BAA4BF37ULL, 0x17EFEE45B0DEE640ULL, 0x1D95B0A5FCF90BC6ULL, 0x93CBE0B699C2585DULL,
+    0x65FA4F227A2B6D79ULL, 0xD5F9E858292504D5ULL, 0xC2B5A03F71471A6FULL, 0x59300222B4561E00ULL,
+    0xCE2F8642CA0712DCULL, 0x7CA9723FBB2E8988ULL, 0x2785338347F2BA08ULL, 0xC61BB3A141E50E8CULL,
+    0x150F361DAB9DEC26ULL, 0x9F6A419D382595F4ULL, 0x64A53DC924FE7AC9ULL, 0x142DE49FFF7A7C3DULL,
+    0x0C335248857FA9E7ULL, 0x0A9C32D5EAE45305ULL, 0xE6C42178C4BBB92EULL, 0x71F1CE2490D20B07ULL,
+    0xF1BCC3D275AFE51AULL, 0xE728E8C83C334074ULL, 0x96FBF83A12884624ULL, 0x81A1549FD6573DA5ULL,
+    0x5FA7867CAF35E149ULL, 0x56986E2EF3ED091BULL, 0x917F1DD5F8886C61ULL, 0xD20D8C88C8FFE65FULL,
+    0x31D71DCE64B2C310ULL, 0xF165B587DF898190ULL, 0xA57E6339DD2CF3A0ULL, 0x1EF6E6DBB1961EC9ULL,
+    0x70CC73D90BC26E24ULL, 0xE21A6B35DF0C3AD7ULL, 0x003A93D8B2806962ULL, 0x1C99DED33CB890A1ULL,
+    0xCF3145DE0ADD4289ULL, 0xD0E4427A5514FB72ULL, 0x77C621CC9FB3A483ULL, 0x67A34DAC4356550BULL,
+    0xF8D626AAAF278509ULL
+};
+
+void initializeBoard(Bitboards *bitboards);
+Board fillBoard(const Bitboards *bitboards, Board board);
+char pieceAt(const Bitboards *bitboards, int square);
+void setPiece(Bitboards *bitboards, int index, int square);
+void placePiece(Bitboards *bitboards, char piece, int square);
+void removePiece(Bitboards *bitboards, int square);
 void printBoard(Board board);
-bool parseFEN(const char *fenStr, GameState *state);
+const char *squareGlyph(char piece, int square);
+void startRenderer(Renderer *renderer);
+void renderBoard(Renderer *renderer, const GameState *state, Move lastMove);
+void stopRenderer(Renderer *renderer);
+char charAt(const char *view, const size_t length, const size_t index) { return index < length ? view[index] : '\0'; }
+bool parseFEN(const char *fenStr, size_t length, GameState *state);
 void loadPosition(GameState *state);
+int writeFEN(const GameState *state, char *buffer);
+int writeNumber(char *buffer, unsigned int number);
 void exportPosition(const GameState *state);
-void getMove(char *buffer, GameState *state, bool *specifyRow, bool *specifyCol);
-bool getLineOfSight(const Position pos1, const Position pos2, Position *list, unsigned short int *count);
-bool hasClearSight(Board board, const Position pos1, const Position pos2);
-bool search(PieceType pieceType, SearchType searchType, Position pos, Position dest, char piece, Board board, Position *candidates, unsigned short int *count, const KingPosition *kingPos);
-bool searchBoard(PieceType type, SearchType SearchType, Position pos, char piece, Board board, Position *candidates, unsigned short int *count, const KingPosition *kingPos);
-bool canMoveTo(Board board, Position target, bool isWhite, KingPosition kingPos, const Move previousMove);
-bool isCheckmate(Board board, KingPosition oppKingPos, Position *checkers, const short int checkerCount, const Move previousMove);
-BoardPosition *convertBoardPosition(GameState *state);
-void updateGameStatus(GameState *state, bool *isCheck);
-bool hasSufficientMaterial(Board board);
-bool isStalemate(Board board, KingPosition kingPos);
-bool compareBoardPositions(const BoardPosition *old, const BoardPosition *new);
-bool isInCheck(Board board, const Position pos, bool isWhite, const Move previousMove, Position *attackers, unsigned short int *attackerCount);
-bool isPossibleMove(Board board, const Move move, const KingPosition *ownKingPos);
-void makeMove(Board board, const Move move);
-bool setMoveToCastle(Move *move, const MoveType type, const KingPosition kingPos);
-bool validateMove(char *move, GameState *state, bool *specifyRow, bool *specifyCol);
-bool findDestination(char *rawMove, Move *move, unsigned short int *destinationIndex);
-bool initializeGameLog(GameLog *game);
-bool resize(GameLog *game);
+void getMove(char *buffer, const GameState *state, LegalMoves *legal, Move *move);
+Bitboard stepAttacks(int square, const short int (*offsets)[2], int count);
+Bitboard slidingAttacks(int square, Bitboard occupied, bool diagonal);
+void initializeMagics(Magic *magics, Bitboard *table, const Bitboard *magicNumbers, bool diagonal);
+void initializeAttackTables(void);
+uint64_t randomNumber(uint64_t *seed);
+void initializeZobristKeys(void);
+uint64_t enPeasantKey(const Bitboards *bitboards, int enPeasant, bool isWhite);
+uint64_t computeKey(const GameState *state);
+unsigned short int countRepetitions(const GameState *state);
+Bitboard attacksFrom(PieceSet set, int square, Bitboard occupied, bool isWhite);
+Bitboard attackersTo(const Bitboards *bitboards, int square, Bitboard occupied, bool byWhite);
+void addMove(MoveList *list, MoveType type, int origin, int destination);
+void updateCheckInfo(GameState *state);
+SPECIALIZED void generateEvasionsFor(const GameState *state, MoveList *list, bool firstOnly, int side);
+void generateEvasions(const GameState *state, MoveList *list, bool firstOnly);
+SPECIALIZED void generateMovesFor(const GameState *state, MoveList *list, int side, bool noisy, bool quiet, Bitboard origins);
+void generateLegalMoves(const GameState *state, MoveList *list);
+void generateMoves(const GameState *state, MoveList *list, bool noisy, bool quiet, Bitboard origins);
+bool isCheckmate(const GameState *state);
+void updateGameStatus(GameState *state, LegalMoves *legal, bool *isCheck);
+bool hasSufficientMaterial(const Bitboards *bitboards);
+bool isInCheck(const Bitboards *bitboards, int square, bool isWhite, Bitboard *attackers);
+bool isPossibleMove(const Bitboards *bitboards, const Move move);
+SPECIALIZED void movePiecesFor(Bitboards *bitboards, const Move move, int side);
+void movePieces(Bitboards *bitboards, const Move move);
+SPECIALIZED void makeMoveFor(GameState *state, const Move move, Undo *undo, int side);
+void makeMove(GameState *state, const Move move, Undo *undo);
+SPECIALIZED void unmakeMoveFor(GameState *state, const Undo *undo, int side);
+void unmakeMove(GameState *state, const Undo *undo);
+void prepareLegalMoves(const GameState *state, LegalMoves *legal);
+bool validateMove(const char *move, const GameState *state, LegalMoves *legal, Move *newMove);
+bool resizeTable(long megabytes);
+bool probeTable(uint64_t key, uint64_t *data);
+void storeTable(uint64_t key, Move move, int score, int depth, Bound bound);
+void initializeEvaluation(void);
+bool loadNetwork(const char *fileName);
+bool randomizeNetwork(void);
+void updateAccumulator(int16_t *accumulator, const int *added, int addedCount, const int *removed, int removedCount);
+void updateEvaluation(Evaluation *evaluation, const PieceChanges *changes);
+void refreshEvaluation(GameState *state);
+int evaluateClassical(const GameState *state);
+int clippedDot(const int16_t *accumulator, const int16_t *weights);
+int evaluateNetwork(const GameState *state);
+int evaluate(const GameState *state);
+uint64_t walkEvaluations(GameState *state, int depth, bool useNetwork, int64_t *sum);
+int runEvaluationBench(int argc, char **argv);
+int staticExchange(const Bitboards *bitboards, const Move move);
+bool isLegalMove(const GameState *state, const Move move);
+int captureScore(const Bitboards *bitboards, const Move move);
+void startPicker(MovePicker *picker, const GameState *state, const Search *search, Move tableMove, int ply, bool capturesOnly);
+Move selectBest(MovePicker *picker);
+Move pickMove(MovePicker *picker, const GameState *state);
+void addHistory(int *entry, int bonus);
+void rewardQuietMove(Search *search, const GameState *state, const Move move, const Move *tried, int triedCount, int depth, int ply);
+bool checkLimits(Search *search);
+bool isSearchDraw(const GameState *state);
+int quiescence(GameState *state, Search *search, int alpha, int beta, int ply);
+int alphaBeta(GameState *state, Search *search, int alpha, int beta, int depth, int ply);
+uint64_t countNodes(const Search *searches, int count);
+void printSearchInfo(const Search *search, int depth, int score, uint64_t nodes);
+void *iterativeDeepening(void *argument);
+Move findBestMove(const GameState *position, const SearchLimits *limits, bool verbose);
+int runBench(int argc, char **argv);
+bool parseCoordinates(const GameState *state, const char *text, Move *move);
+void *uciSearch(void *argument);
+void releaseSearch(SearchJob *job);
+void waitForSearch(SearchJob *job, bool stop);
+int runUci(void);
+char *formatCoordinates(const Move move, char *buffer);
+bool setPosition(const char *fenStr, GameState *state);
+uint64_t perft(GameState *state, int depth, PerftTable *table);
+void *perftWorker(void *argument);
+uint64_t divide(PerftJob *job, int threadCount, bool verbose);
+double elapsedSeconds(const struct timespec *start);
+int runPerft(int argc, char **argv);
+bool appendText(TextBuffer *buffer, const char *text, size_t length);
+bool appendFormatted(TextBuffer *buffer, const char *format, ...);
+void putBytes(char *to, uint64_t value, int size);
+uint64_t readBytes(const void *from, int size);
+bool appendBytes(TextBuffer *buffer, uint64_t value, int size);
+void readAnnotations(const char *comment, const char *end, PgnBatch *batch);
+bool packGame(PgnBatch *batch, const char *fenStr, const char *result, int plyCount);
+bool replayGame(const char *game, unsigned long number, PgnBatch *batch);
+void *pgnWorker(void *argument);
+void printBatches(PgnQueue *queue, bool drain);
+PgnBatch *nextBatch(PgnQueue *queue, const char *fileName, unsigned long firstGame);
+void submitBatch(PgnQueue *queue);
+int runPgn(int argc, char **argv, bool isPacking);
+const char *nextLine(const char *from, const char *end);
+void *fenWorker(void *argument);
+int runFen(int argc, char **argv);
+bool openArchive(const char *fileName, Archive *archive);
+bool readArchiveGame(const Archive *archive, uint64_t number, ArchiveGame *game);
+void *archiveWorker(void *argument);
+int runReplay(int argc, char **argv);
+int runUnpack(int argc, char **argv);
+uint64_t readBigEndian(const unsigned char *from, int size);
+void initializePolyglotKeys(void);
+bool loadPolyglotKeys(const char *fileName);
+bool openBook(const char *fileName);
+uint64_t polyglotKey(const GameState *state);
+uint16_t polyglotMove(const Move move);
+bool probeBook(const GameState *state, Move *move);
+int compareBookEntries(const void *first, const void *second);
+int runBook(int argc, char **argv);
+void addBitbase(int first, int second, bool isSecondBlack);
+void initializeBitbases(void);
+int materialCode(const int *sets, int count);
+Bitbase *findBitbase(const int *pieces, int count, bool *flip);
+uint64_t bitbaseIndex(const Bitbase *bitbase, int whiteKing, int blackKing, const int *pieceSquares, bool isWhite);
+void decodeBitbaseIndex(const Bitbase *bitbase, uint64_t index, int *whiteKing, int *blackKing, int *squares, bool *isWhite);
+Bitbase *locateBitbase(const Bitboards *bitboards, bool isWhite, uint64_t *index);
+bool probeBitbase(const Bitboards *bitboards, bool isWhite, int *result);
+bool canProbeBitbase(const GameState *state);
+int enPeasantResult(const Bitboards *bitboards, bool isWhite, int enPeasant);
+bool setUpEnding(const Bitbase *bitbase, int whiteKing, int blackKing, const int *squares, Bitboards *bitboards);
+unsigned char *buildBitbase(const Bitbase *bitbase);
+bool saveBitbase(const Bitbase *bitbase, const char *directory);
+bool loadBitbase(Bitbase *bitbase, const char *directory);
+bool dependenciesBuilt(const Bitbase *bitbase, bool mark, BitbaseJob *job);
+void *bitbaseWorker(void *argument);
+bool buildBitbases(BitbaseJob *job, int threadCount);
+void loadBitbases(const char *directory);
+int mopUp(const Bitboards *bitboards, bool isWhite);
+int runBitbase(int argc, char **argv);
+int runScript(int argc, char **argv);
+bool initializeGameLog(GameLog *game, const GameState *start);
+void resetGameLog(GameLog *game, const GameState *start);
+Undo *appendMove(GameLog *game, const Move move);
+Move lastLoggedMove(const GameLog *game);
+bool takeBack(GameLog *game, GameState *state);
+void freeGameLog(GameLog *game);
 bool isRow(const int c) { return (0 <= c && c < BOARD_SIZE) || ('1' <= c && c < BOARD_SIZE + '1'); }
 bool isCol(const int c) { return (0 <= c && c < BOARD_SIZE) || ('a' <= c && c < BOARD_SIZE + 'a'); }
-bool logMove(GameLog *game, GameState *state, const bool isCheck, const bool specifyRow, const bool specifyCol);
+char *formatAlgebraic(char *formatMove, const LegalMoves *legal, const Move move);
+char *playAlgebraic(GameState *state, LegalMoves *legal, const Move move, Undo *undo, char *formatMove);
 void createGameFile(GameLog *game, GameStatus status);
 
-int main(void) {
+int main(int argc, char **argv) {
     int exitValue = 0, c = 0;
     char buffer[BUFFER_SIZE];
-    bool recording = false;
+    bool recording = false, isComputer[2] = { false, false }, adjudicate = false, isAdjudicated = false;
+    const char *bitbaseDirectory = DEFAULT_BITBASE_DIRECTORY;
+    char formatMove[MAX_MOVE_SIZE];
+    SearchLimits limits = {0};
+    long hashSize = DEFAULT_HASH_SIZE;
     GameLog gameLog = {0};
+    LegalMoves legal = {0};
+    Renderer renderer = {0};
     GameState state = {
-        .whiteKing = { true, true, 7, 4 },
-        .blackKing = { true, true, 0, 4 },
-        .board = initializeBoard(),
-        .move = { .pieceMoved = 'k' },
-        .moveCounter = 1
+        .castlingRights = WHITESHORT | WHITELONG | BLACKSHORT | BLACKLONG,
+        .moveCounter = 2
     };
+    initializeAttackTables();
+    initializeZobristKeys();
+    initializeEvaluation();
+    initializePolyglotKeys();
+    initializeBitbases();
+    initializeBoard(&state.bitboards);
+    if (argc > 1 && strcmp(argv[1], "perft") == 0) return runPerft(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "pgn") == 0) return runPgn(argc - 2, argv + 2, false);
+    if (argc > 1 && strcmp(argv[1], "pack") == 0) return runPgn(argc - 2, argv + 2, true);
+    if (argc > 1 && strcmp(argv[1], "replay") == 0) return runReplay(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "unpack") == 0) return runUnpack(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "fen") == 0) return runFen(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "book") == 0) return runBook(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "bitbase") == 0) return runBitbase(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "--script") == 0) return runScript(argc - 2, argv + 2);
+    if (argc > 1 && strcmp(argv[1], "evalbench") == 0) return runEvaluationBench(argc - 2, argv + 2);
+    for (int i = 1 + (argc > 1 && strcmp(argv[1], "--uci") == 0); i < argc; ++i) {
+        if (strcmp(argv[i], "--adjudicate") == 0) adjudicate = true;
+        else if (i + 1 == argc) break;
+        else if (strcmp(argv[i], "--threads") == 0) searchThreads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--depth") == 0) limits.depth = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--nodes") == 0) limits.nodes = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--movetime") == 0) limits.moveTime = atol(argv[++i]);
+        else if (strcmp(argv[i], "--hash") == 0) hashSize = atol(argv[++i]);
+        else if (strcmp(argv[i], "--bitbases") == 0) bitbaseDirectory = argv[++i];
+        else if (strcmp(argv[i], "--book") == 0) {
+            ASSERT(openBook(argv[++i]), "Could not open the opening book.")
+        } else if (strcmp(argv[i], "--book-keys") == 0) {
+            ASSERT(loadPolyglotKeys(argv[++i]), "Could not read the 781 Polyglot keys from the key file.")
+        } else if (strcmp(argv[i], "--network") == 0) {
+            ASSERT(loadNetwork(argv[++i]), "Could not read the network file.")
+        }
+    }
+    // The computer thinks for one second per move unless other limits were given
+    if (!limits.depth && !limits.nodes && !limits.moveTime) limits.moveTime = 1000;
+    if (searchThreads < 1) searchThreads = 1;
+    if (searchThreads > MAX_THREADS) searchThreads = MAX_THREADS;
+    ASSERT(hashSize >= 1 && hashSize <= MAX_HASH_SIZE, "The hash table size has to be between 1 and 65536 MB.")
+    ASSERT(resizeTable(hashSize), "Could not allocate the hash table.")
+    loadBitbases(bitbaseDirectory);
+    if (argc > 1 && strcmp(argv[1], "--uci") == 0) {
+        exitValue = runUci();
+        goto exit;
+    }
+    if (argc > 1 && strcmp(argv[1], "bench") == 0) {
+        exitValue = runBench(argc - 2, argv + 2);
+        goto exit;
+    }
 
-    puts("--------------------------------\nWelcome to chess!\n--------------------------------\n\nTo load a position from FEN notation, type \"load\".\nTo start a game, type \"start\".\nAt any point during the game, typing \"export\" will generate the FEN notation for the current position.\n");
+    puts("--------------------------------\nWelcome to chess!\n--------------------------------\n\nTo load a position from FEN notation, type \"load\".\nTo start a game, type \"start\".\nAt any point during the game, typing \"export\" will generate the FEN notation for the current position and \"undo\" takes back the last move.\nTyping \"hash <MB>\" sets the size of the computer's hash table and \"threads <n>\" the number of threads it searches with.\n");
     while (true) {
         GET_INPUT("Do you want to load a position or start the game? ")
         if (strcmp(&buffer[c], "start") == 0) break;
@@ -180,20 +1182,60 @@ int main(void) {
         recording = tolower(buffer[c]) == 'y';
         if (recording || tolower(buffer[c] == 'n')) break;
     }
-    ASSERT(!recording || initializeGameLog(&gameLog), "Could not start recording the game.")
-    convertBoardPosition(&state);
+    while (true) {
+        GET_INPUT("Which side should the computer play? (white|black|both|none) ")
+        isComputer[WHITE] = strcmp(&buffer[c], "white") == 0 || strcmp(&buffer[c], "both") == 0;
+        isComputer[BLACK] = strcmp(&buffer[c], "black") == 0 || strcmp(&buffer[c], "both") == 0;
+        if (isComputer[WHITE] || isComputer[BLACK] || strcmp(&buffer[c], "none") == 0) break;
+    }
+    state.key = state.keyHistory[0] = computeKey(&state);
+    updateCheckInfo(&state);
+    ASSERT(initializeGameLog(&gameLog, &state), "Could not start the game.")
+    startRenderer(&renderer);
+    // A loaded position may already be decided, in which case nobody gets to move
+    {
+        bool isCheck = false;
+        updateGameStatus(&state, &legal, &isCheck);
+    }
 
-    do {
-        bool isCheck = false, specifyRow = false, specifyCol = false;
-        ++state.moveCounter;
-        printBoard(state.board);
-        getMove(buffer, &state, &specifyRow, &specifyCol);
-        makeMove(state.board, state.move);
-        updateGameStatus(&state, &isCheck);
-        if (recording) ASSERT(logMove(&gameLog, &state, isCheck, specifyRow, specifyCol), "Unable to record the move.")
-    } while (state.status == WHITE || state.status == BLACK);
-
-    if (state.move.type != PLAYERDRAW && state.move.type != RESIGN) printBoard(state.board);
+    while (state.status == WHITE || state.status == BLACK) {
+        bool isCheck = false;
+        Move move;
+        int result;
+        // Ends the game as soon as the bitbases know how it ends with best play
+        if (adjudicate && canProbeBitbase(&state) && probeBitbase(&state.bitboards, state.status == WHITE, &result)) {
+            state.status = !result ? DRAWBYBITBASE : (result > 0) == (state.status == WHITE) ? WIN : LOSE;
+            isAdjudicated = true;
+            break;
+        }
+        renderBoard(&renderer, &state, lastLoggedMove(&gameLog));
+        const bool isComputerMove = isComputer[state.status], isWhite = state.status == WHITE;
+        if (isComputerMove) {
+            stopSearch = false;
+            if (!probeBook(&state, &move)) move = findBestMove(&state, &limits, false);
+            // The side to move always has a legal move here, so an empty result can only come from an interrupted search
+            if (!move) {
+                prepareLegalMoves(&state, &legal);
+                move = legal.list.moves[0];
+            }
+        } else getMove(buffer, &state, &legal, &move);
+        if (moveType(move) == TAKEBACK) {
+            // The computer's replies are taken back as well, so the player is to move again
+            if (!takeBack(&gameLog, &state)) puts("There is no move to take back.");
+            while (isComputer[state.status] && takeBack(&gameLog, &state));
+            continue;
+        }
+        if (moveType(move) == PLAYERDRAW || moveType(move) == RESIGN) state.move = move;
+        else {
+            Undo *const undo = appendMove(&gameLog, move);
+            ASSERT(undo, "Unable to record the move.")
+            playAlgebraic(&state, &legal, move, undo, formatMove);
+        }
+        updateGameStatus(&state, &legal, &isCheck);
+        if (isComputerMove) printf("%d. %s plays %s\n", (state.moveCounter - 1) / 2, isWhite ? White : Black, formatMove);
+    }
+
+    if (moveType(state.move) != PLAYERDRAW && moveType(state.move) != RESIGN) renderBoard(&renderer, &state, lastLoggedMove(&gameLog));
     switch (state.status) {
         case DRAWBYPLAYER:
             puts("It's a draw!");
@@ -210,20 +1252,30 @@ int main(void) {
         case STALEMATE:
             puts("It's stalemate!");
             break;
+        case DRAWBYBITBASE:
+            puts("The bitbase shows that neither side can force a win.\nIt's a draw!");
+            break;
         default:
+            if (isAdjudicated) puts("The bitbase shows that the ending is won with best play.");
             printf("%s wins!\n", state.status == WIN ? White : Black);
     }
     if (recording) createGameFile(&gameLog, state.status);
 
 exit:
-    if (recording) free(gameLog.log);
-    free(state.board);
+    stopRenderer(&renderer);
+    freeGameLog(&gameLog);
+    free(transpositionTable.clusters);
+    free(network);
+    if (openingBook.entries) munmap((void *)openingBook.entries, openingBook.count * 16);
+    for (int i = 0; i < bitbaseCount; ++i) {
+        if (bitbases[i].mappedSize) munmap((void *)(bitbases[i].table - 16), bitbases[i].mappedSize);
+        else free((void *)bitbases[i].table);
+    }
     return exitValue;
 }
 
-Board initializeBoard(void) {
-    Board board = malloc(sizeof(char) * BOARD_SIZE * BOARD_SIZE);
-    char boardString[BOARD_SIZE * BOARD_SIZE] = {
+void initializeBoard(Bitboards *const restrict bitboards) {
+    const char boardString[BOARD_SIZE * BOARD_SIZE] = {
         'r', 'n', 'b', 'q', 'k', 'b', 'n', 'r',
         'p', 'p', 'p', 'p', 'p', 'p', 'p', 'p',
         ' ', ' ', ' ', ' ', ' ', ' ', ' ', ' ',
@@ -233,93 +1285,134 @@ Board initializeBoard(void) {
         'P', 'P', 'P', 'P', 'P', 'P', 'P', 'P',
         'R', 'N', 'B', 'Q', 'K', 'B', 'N', 'R'
     };
-    for (int i = 0; i < BOARD_SIZE; ++i)
-        for (int j = 0; j < BOARD_SIZE; ++j)
-            board[i][j] = boardString[i * BOARD_SIZE + j];
+    *bitboards = (Bitboards){0};
+    for (int i = 0; i < BOARD_SIZE * BOARD_SIZE; ++i) if (boardString[i] != ' ') placePiece(bitboards, boardString[i], i);
+}
+
+// Copies the position into a board for printing
+Board fillBoard(const Bitboards *const restrict bitboards, Board board) {
+    for (int i = 0; i < BOARD_SIZE; ++i) for (int j = 0; j < BOARD_SIZE; ++j) board[i][j] = pieceAt(bitboards, i * BOARD_SIZE + j);
     return board;
 }
 
+char pieceAt(const Bitboards *const restrict bitboards, const int square) {
+    return bitboards->occupied & bit(square) ? PIECE_SYMBOLS[bitboards->squares[square]] : ' ';
+}
+
+// Puts the piece with the given index into PIECE_SYMBOLS on an empty square
+void setPiece(Bitboards *const restrict bitboards, const int index, const int square) {
+    bitboards->pieces[index / 6][index % 6] |= bit(square);
+    bitboards->occupancy[index / 6] |= bit(square);
+    bitboards->occupied |= bit(square);
+    bitboards->squares[square] = index;
+}
+
+void placePiece(Bitboards *const restrict bitboards, const char piece, const int square) {
+    setPiece(bitboards, pieceIndex(piece), square);
+}
+
+// The mailbox names the only set the piece is in, so an empty square is left as it is
+void removePiece(Bitboards *const restrict bitboards, const int square) {
+    if (!(bitboards->occupied & bit(square))) return;
+    const int index = bitboards->squares[square];
+    bitboards->pieces[index / 6][index % 6] &= ~bit(square);
+    bitboards->occupancy[index / 6] &= ~bit(square);
+    bitboards->occupied &= ~bit(square);
+}
+
 void printBoard(Board board) {
+    char frame[BOARD_SIZE * (BOARD_SIZE * 3 + 1) + 1] = "";
     for (int i = 0; i < BOARD_SIZE; ++i) {
-        for (int j = 0; j < BOARD_SIZE; ++j) {
-            switch (board[i][j]) {
-                case 'R':
-                    printf("♜");
-                    break;
-                case 'r':
-                    printf("♖");
-                    break;
-                case 'N':
-                    printf("♞");
-                    break;
-                case 'n':
-                    printf("♘");
-                    break;
-                case 'B':
-                    printf("♝");
-                    break;
-                case 'b':
-                    printf("♗");
-                    break;
-                case 'Q':
-                    printf("♛");
-                    break;
-                case 'q':
-                    printf("♕");
-                    break;
-                case 'K':
-                    printf("♚");
-                    break;
-                case 'k':
-                    printf("♔");
-                    break;
-                case 'P':
-                    printf("♟");
-                    break;
-                case 'p':
-                    printf("♙");
-                    break;
-                default:
-                    printf((i + j) % 2 == 0 ? "■" : "□");
-            }
-        }
-        putchar('\n');
+        for (int j = 0; j < BOARD_SIZE; ++j) strcat(frame, squareGlyph(board[i][j], i * BOARD_SIZE + j));
+        strcat(frame, "\n");
+    }
+    fputs(frame, stdout);
+}
+
+// White pieces are drawn with the filled symbols, empty squares alternate between filled and hollow boxes
+const char *squareGlyph(const char piece, const int square) {
+    static const char *const pieceGlyphs[12] = { "♟", "♞", "♝", "♜", "♛", "♚", "♙", "♘", "♗", "♖", "♕", "♔" };
+    if (piece == ' ') return (square / BOARD_SIZE + square % BOARD_SIZE) % 2 == 0 ? "■" : "□";
+    return pieceGlyphs[pieceIndex(piece)];
+}
+
+// Clears the screen and keeps the rows below the board scrolling, if stdout is a terminal that understands ANSI escape codes
+void startRenderer(Renderer *const restrict renderer) {
+    const char *const terminal = getenv("TERM");
+    *renderer = (Renderer){ .isEnabled = isatty(STDOUT_FILENO) && terminal && strcmp(terminal, "dumb") != 0 };
+    if (!renderer->isEnabled) return;
+    printf("\x1b[2J\x1b[%dr\x1b[%d;1H", BOARD_SIZE + 2, BOARD_SIZE + 2);
+    fflush(stdout);
+}
+
+// Repaints only the squares whose piece or highlight changed, addressing each one with the cursor and sending the frame in a single write.
+// Without a capable terminal the whole board is printed instead
+void renderBoard(Renderer *const restrict renderer, const GameState *const restrict state, const Move lastMove) {
+    static const char *const highlightCodes[3] = { "", "\x1b[43m", "\x1b[41m" };
+    char frame[BOARD_SIZE * BOARD_SIZE * 24 + 8] = "\x1b" "7", view[BOARD_SIZE][BOARD_SIZE];
+    size_t length = 2;
+    if (!renderer->isEnabled) {
+        printBoard(fillBoard(&state->bitboards, view));
+        return;
     }
+    const int checked = state->checkers ? lsb(state->bitboards.pieces[state->moveCounter & 1][KINGS]) : -1;
+    for (int square = 0; square < BOARD_SIZE * BOARD_SIZE; ++square) {
+        const char piece = pieceAt(&state->bitboards, square);
+        const Highlight highlight = square == checked ? CHECKHIGHLIGHT : lastMove && (square == moveOrigin(lastMove) || square == moveDestination(lastMove)) ? MOVEHIGHLIGHT : NOHIGHLIGHT;
+        if (renderer->pieces[square] == piece && renderer->highlights[square] == highlight) continue;
+        renderer->pieces[square] = piece;
+        renderer->highlights[square] = highlight;
+        length += snprintf(&frame[length], sizeof(frame) - length, "\x1b[%d;%dH%s%s\x1b[0m", square / BOARD_SIZE + 1, square % BOARD_SIZE + 1, highlightCodes[highlight], squareGlyph(piece, square));
+    }
+    if (length == 2) return;
+    length += snprintf(&frame[length], sizeof(frame) - length, "\x1b" "8");
+    fflush(stdout);
+    const char *pending = frame;
+    for (ssize_t written; length && (written = write(STDOUT_FILENO, pending, length)) > 0; pending += written) length -= written;
+}
+
+// Hands the whole screen back to scrolling, leaving the cursor where the prompts stopped
+void stopRenderer(Renderer *const restrict renderer) {
+    if (!renderer->isEnabled) return;
+    printf("\x1b" "7\x1b[r\x1b" "8");
+    fflush(stdout);
+    renderer->isEnabled = false;
 }
 
-bool parseFEN(const char *const restrict fenStr, GameState *const restrict state) {
+// Reads a FEN string from a view that does not need to be terminated and stops at the first whitespace after the move number.
+// EPD records end after the en peasant square or go on with operations, they get a halfmove clock of 0 and move number 1
+bool parseFEN(const char *const restrict fenStr, const size_t length, GameState *const restrict state) {
     const char validPieces[22] = "rnbqkpRNBQKP12345678/";
-    unsigned short int iter = 0, i = 0, j = 0;
+    const Bitboard *const white = state->bitboards.pieces[WHITE], *const black = state->bitboards.pieces[BLACK];
+    size_t iter = 0;
+    unsigned short int i = 0, j = 0;
+    unsigned int halfmoves = 0, fullmoves = 1;
     bool seenWhiteKing = false, seenBlackKing = false;
-    while (strchr(validPieces, fenStr[iter])) {
+    char c;
+    while ((c = charAt(fenStr, length, iter)) && strchr(validPieces, c)) {
         if (i >= BOARD_SIZE || j > BOARD_SIZE) return false;
-        if (isalpha(fenStr[iter])) {
-            if (fenStr[iter] == 'K') {
+        if (isalpha(c)) {
+            if (c == 'K') {
                 if (seenWhiteKing) return false;
                 seenWhiteKing = true;
-                state->whiteKing.row = i;
-                state->whiteKing.col = j;
-            } else if (fenStr[iter] == 'k') {
+            } else if (c == 'k') {
                 if (seenBlackKing) return false;
                 seenBlackKing = true;
-                state->blackKing.row = i;
-                state->blackKing.col = j;
-            }
-            state->board[i][j++] = fenStr[iter];
-        } else if (isdigit(fenStr[iter])) {
-            for (int k = 0; k < fenStr[iter] - '0'; ++k) {
-                state->board[i][j++] = ' ';
-                if (j > BOARD_SIZE) return false;
             }
+            if (j >= BOARD_SIZE) return false;
+            placePiece(&state->bitboards, c, i * BOARD_SIZE + j++);
+        } else if (isdigit(c)) {
+            j += c - '0';
+            if (j > BOARD_SIZE) return false;
         } else {
             ++i;
             j = 0;
         }
         ++iter;
     }
-    if (i != BOARD_SIZE - 1 || j != BOARD_SIZE) return false;
-    if (fenStr[iter++] != ' ') return false;
-    switch(fenStr[iter++]) {
+    if (i != BOARD_SIZE - 1 || j != BOARD_SIZE || !seenWhiteKing || !seenBlackKing) return false;
+    if (charAt(fenStr, length, iter++) != ' ') return false;
+    switch (charAt(fenStr, length, iter++)) {
         case 'w':
             state->status = WHITE;
             break;
@@ -329,27 +1422,27 @@ bool parseFEN(const char *const restrict fenStr, GameState *const restrict state
         default:
             return false;
     }
-    if (fenStr[iter++] != ' ') return false;
+    if (charAt(fenStr, length, iter++) != ' ') return false;
     bool seenBlack = false;
-    if (fenStr[iter] != '-') {
+    if (charAt(fenStr, length, iter) != '-') {
         bool shouldBreak = false;
         for (i = 0; i < 4; ++i) {
-            switch(fenStr[iter]) {
+            switch (charAt(fenStr, length, iter)) {
                 case 'K':
                     if (seenBlack) return false;
-                    state->whiteKing.canCastleShort = true;
+                    state->castlingRights |= WHITESHORT;
                     break;
                 case 'Q':
                     if (seenBlack) return false;
-                    state->whiteKing.canCastleLong = true;
+                    state->castlingRights |= WHITELONG;
                     break;
                 case 'k':
                     seenBlack = true;
-                    state->blackKing.canCastleShort = true;
+                    state->castlingRights |= BLACKSHORT;
                     break;
                 case 'q':
                     seenBlack = true;
-                    state->blackKing.canCastleLong = true;
+                    state->castlingRights |= BLACKLONG;
                     break;
                 case ' ':
                     shouldBreak = true;
@@ -361,101 +1454,112 @@ bool parseFEN(const char *const restrict fenStr, GameState *const restrict state
             ++iter;
         }
     } else ++iter;
-    if (fenStr[iter++] != ' ') return false;
-    if (fenStr[iter] != '-') {
-        char col = fenStr[iter++];
+    if (charAt(fenStr, length, iter++) != ' ') return false;
+    if (charAt(fenStr, length, iter) != '-') {
+        char col = charAt(fenStr, length, iter++);
         if (col < 'a' || 'h' < col) return false;
-        state->move.origin.col = col - 'a';
-        state->move.destination.col = col - 'a';
-        char row = fenStr[iter++];
+        char row = charAt(fenStr, length, iter++);
         if (row != '6' && state->status == WHITE) return false;
         if (row != '3' && state->status == BLACK) return false;
-        state->move.origin.row = row - '2' + (state->status == BLACK) * 2;
-        state->move.destination.row = row - '2' + (state->status == WHITE) * 2;
+        state->enPeasant = ('8' - row) * BOARD_SIZE + col - 'a';
     } else ++iter;
-    if (fenStr[iter++] != ' ') return false;
-    for (i = 0; i < 3; ++i) {
-        if (!isdigit(fenStr[iter])) return false;
-        state->movesWithoutCaptures *= 10;
-        state->movesWithoutCaptures += fenStr[iter++] - '0';
-        if (fenStr[iter++] == ' ') break;
-    }
-    if (i == 3) return false;
-    Position attackers[16];
-    unsigned short int attackerCount = 0;
-    if (isInCheck(state->board, state->status == WHITE ? getRegPos(state->whiteKing) : getRegPos(state->blackKing), state->status == WHITE, state->move, attackers, &attackerCount) && isCheckmate(state->board, state->status == WHITE ? state->whiteKing : state->blackKing, attackers, attackerCount, state->move)) state->status = state->status == BLACK ? WIN : LOSE;
-    while (true) {
-        if (!isdigit(fenStr[iter])) return false;
-        state->moveCounter *= 10;
-        state->moveCounter += fenStr[iter] - '0';
-        if (fenStr[++iter] != '\n') continue;
-        state->moveCounter *= 2;
-        return true;
+    c = charAt(fenStr, length, iter);
+    if (c && !isspace(c)) return false;
+    while (charAt(fenStr, length, iter) == ' ') ++iter;
+    if (isdigit(charAt(fenStr, length, iter))) {
+        for (; isdigit(c = charAt(fenStr, length, iter)); ++iter) if ((halfmoves = halfmoves * 10 + c - '0') > 999) return false;
+        if (charAt(fenStr, length, iter++) != ' ' || !isdigit(charAt(fenStr, length, iter))) return false;
+        for (fullmoves = 0; isdigit(c = charAt(fenStr, length, iter)); ++iter) if ((fullmoves = fullmoves * 10 + c - '0') > 9999) return false;
+        if (c && !isspace(c)) return false;
     }
+    // Rights whose king or rook has left its square and en peasant squares without the pawn that just passed them can never be used
+    if (!(white[KINGS] & bit(60)) || !(white[ROOKS] & bit(63))) state->castlingRights &= ~WHITESHORT;
+    if (!(white[KINGS] & bit(60)) || !(white[ROOKS] & bit(56))) state->castlingRights &= ~WHITELONG;
+    if (!(black[KINGS] & bit(4)) || !(black[ROOKS] & bit(7))) state->castlingRights &= ~BLACKSHORT;
+    if (!(black[KINGS] & bit(4)) || !(black[ROOKS] & bit(0))) state->castlingRights &= ~BLACKLONG;
+    if (state->enPeasant) {
+        const int pushed = state->status == WHITE ? state->enPeasant + BOARD_SIZE : state->enPeasant - BOARD_SIZE;
+        const int origin = state->status == WHITE ? state->enPeasant - BOARD_SIZE : state->enPeasant + BOARD_SIZE;
+        if (!(state->bitboards.pieces[state->status == WHITE ? BLACK : WHITE][PAWNS] & bit(pushed)) || (state->bitboards.occupied & (bit(state->enPeasant) | bit(origin)))) state->enPeasant = 0;
+    }
+    // Pawns can never stand on the first or last rank, and the king of the side that just moved cannot be left in check
+    if ((white[PAWNS] | black[PAWNS]) & BACK_RANKS) return false;
+    const Bitboard *const waiting = state->status == WHITE ? black : white;
+    if (attackersTo(&state->bitboards, lsb(waiting[KINGS]), state->bitboards.occupied, state->status == WHITE)) return false;
+    state->movesWithoutCaptures = halfmoves;
+    state->moveCounter = fullmoves * 2 + (state->status == BLACK);
+    updateCheckInfo(state);
+    if (isCheckmate(state)) state->status = state->status == WHITE ? LOSE : WIN;
+    return true;
 }
 
 void loadPosition(GameState *const restrict state) {
     char buffer[BUFFER_SIZE];
     GameState loadedState = {
-        .board = initializeBoard(),
-        .move = {0},
+        .move = 0,
     };
     do {
         memset(buffer, 0, BUFFER_SIZE);
+        loadedState = (GameState){ .move = 0 };
         printf("\nPlease enter the FEN notation: ");
         fgets(buffer, BUFFER_SIZE, stdin);
-        if (parseFEN(buffer, &loadedState)) break;
+        if (parseFEN(buffer, strlen(buffer), &loadedState)) break;
         printf("\nThat was not a valid FEN notation.");
     } while (true);
-    state->whiteKing = loadedState.whiteKing;
-    state->blackKing = loadedState.blackKing;
-    state->status = loadedState.status;
-    state->move = loadedState.move;
-    state->movesWithoutCaptures = loadedState.movesWithoutCaptures;
-    state->moveCounter = loadedState.moveCounter;
-    for (int i = 0; i < BOARD_SIZE; ++i) for (int j = 0; j < BOARD_SIZE; ++j) state->board[i][j] = loadedState.board[i][j];
-    free(loadedState.board);
+    *state = loadedState;
 }
 
-void exportPosition(const GameState *const restrict state) {
-    putchar('\n');
-    unsigned short int spaceCounter = 0;
-    bool canCastle = false;
+// Writes the position as a FEN string into a buffer of at least BUFFER_SIZE characters, returns its length
+int writeFEN(const GameState *const restrict state, char *const restrict buffer) {
+    int length = 0;
     for (int i = 0; i < BOARD_SIZE; ++i) {
+        unsigned short int spaceCounter = 0;
         for (int j = 0; j < BOARD_SIZE; ++j) {
-            char piece = state->board[i][j];
-            switch(piece) {
-                case ' ':
-                    ++spaceCounter;
-                    break;
-                default:
-                    if (spaceCounter > 0) {
-                        printf("%d", spaceCounter);
-                        spaceCounter = 0;
-                    }
-                    putchar(piece);
+            const char piece = pieceAt(&state->bitboards, i * BOARD_SIZE + j);
+            if (piece == ' ') {
+                ++spaceCounter;
+                continue;
             }
-        }
-        if (spaceCounter > 0) {
-            printf("%d", spaceCounter);
+            if (spaceCounter > 0) buffer[length++] = '0' + spaceCounter;
             spaceCounter = 0;
+            buffer[length++] = piece;
         }
-        putchar(i < BOARD_SIZE - 1 ? '/' : ' ');
+        if (spaceCounter > 0) buffer[length++] = '0' + spaceCounter;
+        buffer[length++] = i < BOARD_SIZE - 1 ? '/' : ' ';
     }
-    printf("%c ", state->status == WHITE ? 'w' : 'b');
-    if (state->whiteKing.canCastleShort) { printf("K"); canCastle = true; }
-    if (state->whiteKing.canCastleShort) { printf("Q"); canCastle = true; }
-    if (state->blackKing.canCastleShort) { printf("k"); canCastle = true; }
-    if (state->blackKing.canCastleShort) { printf("q"); canCastle = true; }
-    if (!canCastle) putchar('-');
-    if (state->move.type == DOUBLEPAWNMOVE) {
-        printf(" %c%c ", state->move.destination.col + 'a', '8' - (state->move.destination.row - 1 + (state->move.origin.row == BOARD_SIZE - 2) * 2));
-    } else printf(" - ");
-    printf("%d %d\n", state->movesWithoutCaptures - 1, state->moveCounter / 2);
-    printf("\n%d. %s to move: ", state->moveCounter / 2, state->status == WHITE ? White : Black);
+    buffer[length++] = state->moveCounter % 2 ? 'b' : 'w';
+    buffer[length++] = ' ';
+    for (int i = 0; i < 4; ++i) if (state->castlingRights & (1 << i)) buffer[length++] = "KQkq"[i];
+    if (!state->castlingRights) buffer[length++] = '-';
+    buffer[length++] = ' ';
+    if (state->enPeasant) {
+        buffer[length++] = state->enPeasant % BOARD_SIZE + 'a';
+        buffer[length++] = '8' - state->enPeasant / BOARD_SIZE;
+    } else buffer[length++] = '-';
+    buffer[length++] = ' ';
+    length += writeNumber(&buffer[length], state->movesWithoutCaptures);
+    buffer[length++] = ' ';
+    length += writeNumber(&buffer[length], state->moveCounter / 2);
+    buffer[length] = '\0';
+    return length;
+}
+
+// Writes the digits of the number without a terminator, returns how many there are
+int writeNumber(char *const restrict buffer, unsigned int number) {
+    char digits[10];
+    int count = 0;
+    do digits[count++] = '0' + number % 10; while (number /= 10);
+    for (int i = 0; i < count; ++i) buffer[i] = digits[count - 1 - i];
+    return count;
+}
+
+void exportPosition(const GameState *const restrict state) {
+    char fenStr[BUFFER_SIZE];
+    writeFEN(state, fenStr);
+    printf("\n%s\n\n", fenStr);
 }
 
-void getMove(char *const restrict buffer, GameState *const restrict state, bool *const restrict specifyRow, bool *const restrict specifyCol) {
+void getMove(char *const restrict buffer, const GameState *const restrict state, LegalMoves *const restrict legal, Move *const restrict move) {
     const unsigned short int moveNumber = state->moveCounter / 2;
     const GameStatus status = state->status;
     int c;
@@ -463,578 +1567,2875 @@ void getMove(char *const restrict buffer, GameState *const restrict state, bool
         GET_INPUT("%d. %s to move: ", moveNumber, status == WHITE ? White : Black)
         if (strcmp(&buffer[c], "export") == 0) {
             exportPosition(state);
-            return;
+        } else if (strncmp(&buffer[c], "hash ", 5) == 0) {
+            const long hashSize = atol(&buffer[c + 5]);
+            if (hashSize < 1 || hashSize > MAX_HASH_SIZE) printf("The hash table size has to be between 1 and %d MB.\n", MAX_HASH_SIZE);
+            else if (resizeTable(hashSize)) printf("The hash table now uses %llu MB.\n", (unsigned long long)((transpositionTable.mask + 1) * sizeof(Cluster)) >> 20);
+            else puts("Could not allocate a hash table of that size.");
+        } else if (strncmp(&buffer[c], "threads ", 8) == 0) {
+            const int threadCount = atoi(&buffer[c + 8]);
+            if (threadCount < 1 || threadCount > MAX_THREADS) printf("The number of threads has to be between 1 and %d.\n", MAX_THREADS);
+            else printf("The computer now searches with %d thread%s.\n", searchThreads = threadCount, threadCount > 1 ? "s" : "");
         } else if (strcmp(&buffer[c], "draw") == 0) {
-            state->move.type = PLAYERDRAW;
+            *move = createMove(PLAYERDRAW, 0, 0);
             return;
         } else if (strcmp(&buffer[c], "resign") == 0) {
-            state->move.type = RESIGN;
+            *move = createMove(RESIGN, 0, 0);
             return;
-        } else if (validateMove(buffer, state, specifyRow, specifyCol)) return;
-    }
-}
-
-// Has a max return value of 6 Positions inside the list
-bool getLineOfSight(const Position pos1, const Position pos2, Position *const restrict list, unsigned short int *const restrict count) {
-    short int start = pos1.row < pos2.row ? pos1.row : pos2.row, end = pos1.row < pos2.row ? pos2.row : pos1.row;
-    if (abs(pos1.row - pos2.row) == abs(pos1.col - pos2.col)) {
-        for (++start; start < end; ++start) list[(*count)++] = (Position){start, pos1.col + ((pos1.row - pos2.row)/(pos1.col - pos2.col)) * (start - pos1.row)};
-    } else if (pos1.row == pos2.row) {
-        start = pos1.col < pos2.col ? pos1.col : pos2.col;
-        end = pos1.col < pos2.col ? pos2.col : pos1.col;
-        for (++start; start < end; ++start) list[(*count)++] = (Position){pos1.row, start};
-    } else if (pos1.col == pos2.col) {
-        for (++start; start < end; ++start) list[(*count)++] = (Position){start, pos1.col};
-    } else return false;
-    return true;
+        } else if (strcmp(&buffer[c], "undo") == 0 || strcmp(&buffer[c], "takeback") == 0) {
+            *move = createMove(TAKEBACK, 0, 0);
+            return;
+        } else if (validateMove(&buffer[c], state, legal, move)) return;
+    }
 }
 
-bool hasClearSight(Board board, const Position pos1, const Position pos2) {
-    Position list[6];
-    unsigned short int count = 0;
-    if (!getLineOfSight(pos1, pos2, list, &count)) return false;
-    for (int i = 0; i < count; ++i) if (boardAt(list[i]) != ' ') return false;
-    return true;
+const short int knightOffsets[8][2] = { { -2, -1 }, { -2, 1 }, { -1, -2 }, { -1, 2 }, { 1, -2 }, { 1, 2 }, { 2, -1 }, { 2, 1 } };
+const short int kingOffsets[8][2] = { { -1, -1 }, { -1, 0 }, { -1, 1 }, { 0, -1 }, { 0, 1 }, { 1, -1 }, { 1, 0 }, { 1, 1 } };
+const short int pawnOffsets[2][2][2] = { { { -1, -1 }, { -1, 1 } }, { { 1, -1 }, { 1, 1 } } };
+
+Bitboard stepAttacks(const int square, const short int (*const offsets)[2], const int count) {
+    Bitboard attacks = 0;
+    for (int i = 0; i < count; ++i) {
+        const int row = square / BOARD_SIZE + offsets[i][0], col = square % BOARD_SIZE + offsets[i][1];
+        if (onBoard(row, col)) attacks |= bit(row * BOARD_SIZE + col);
+    }
+    return attacks;
 }
 
-bool search(const PieceType pieceType, const SearchType searchType, const Position pos, const Position dest, const char piece, const Board board, Position *const restrict candidates, unsigned short int *const restrict count, const KingPosition *const restrict kingPos) {
-    if (comparePositions(pos, dest)) return false;
-    const bool isWhite = hasSameColor(piece, true);
-    Move move = { NORMALMOVE, pos, dest, piece, false, ' ' };
-    switch (searchType) {
-        case FINDPIECES:
-            if ((boardAt(dest) == piece) && ((pieceType == KNIGHT || pieceType == KING) ? true : hasClearSight(board, pos, dest))) candidates[(*count)++] = dest;
-            return false;
-        case ISLEGALMOVE:
-            if (((pieceType == KNIGHT || pieceType == KING) ? true : hasClearSight(board, pos, dest)) && !hasSameColor(boardAt(dest), isWhite)) {
-                if (hasSameColor(boardAt(dest), !isWhite) || (pieceType == PAWN && abs(pos.col - dest.col) == 1)) move.captures = true;
-                if (pieceType == PAWN && abs(pos.row - dest.row) == 2) move.type = DOUBLEPAWNMOVE;
-                if (isPossibleMove(board, move, kingPos)) return true;
-            }
-            return false;
+// Walks every ray until it is blocked, only used to fill the attack tables
+Bitboard slidingAttacks(const int square, const Bitboard occupied, const bool diagonal) {
+    const short int directions[2][4][2] = { { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } }, { { -1, -1 }, { -1, 1 }, { 1, -1 }, { 1, 1 } } };
+    Bitboard attacks = 0;
+    for (int i = 0; i < 4; ++i) {
+        const short int *const direction = directions[diagonal][i];
+        int row = square / BOARD_SIZE + direction[0], col = square % BOARD_SIZE + direction[1];
+        for (; onBoard(row, col); row += direction[0], col += direction[1]) {
+            attacks |= bit(row * BOARD_SIZE + col);
+            if (occupied & bit(row * BOARD_SIZE + col)) break;
+        }
     }
+    return attacks;
 }
 
-// type = pawn will run ISLEGALMOVE no matter what the given function is
-bool searchBoard(const PieceType pieceType, const SearchType searchType, Position pos, const char piece, const Board board, Position *const restrict candidates, unsigned short int *const restrict count, const KingPosition *const restrict kingPos) {
-    bool isWhite;
-    switch (pieceType) {
-        case ROOK:
-            for (int i = 0; i < 2; ++i) {
-                short int j = 0;
-                short int *const row = i == 0 ? &(pos.row) : &j;
-                short int *const col = i == 1 ? &(pos.col) : &j;
-                for (; j < BOARD_SIZE; ++j) if (search(pieceType, searchType, pos, (Position){ *row, *col }, piece, board, candidates, count, kingPos)) return true;
-            }
-            return false;
-        case KNIGHT:
-            for (short int i = pos.row - 2; i <= pos.row + 2; ++i) for (short int j = pos.col - 2; isRow(i) && j <= pos.col + 2; ++j) {
-                if (!isCol(j)) continue;
-                const Position dest = { i, j };
-                if (isKnightMove(dest, pos) && search(pieceType, searchType, pos, dest, piece, board, candidates, count, kingPos)) return true;
-            }
-            return false;
-        case BISHOP:
-            for (int i = -1; i < 2; i += 2) for (short int r = 0; r < BOARD_SIZE; ++r) {
-                const short int col = pos.col + i * (r - pos.row);
-                if (isCol(col) && search(pieceType, searchType, pos, (Position){ r, col }, piece, board, candidates, count, kingPos)) return true;
-            }
-            return false;
-        case QUEEN:
-            return searchBoard(ROOK, searchType, pos, piece, board, candidates, count, kingPos) || searchBoard(BISHOP, searchType, pos, piece, board, candidates, count, kingPos);
-        case KING:
-            for (short int i = pos.row - 1; i <= pos.row + 1; ++i)
-                for (short int j = pos.col - 1; isRow(i) && j <= pos.col + 1; ++j)
-                    if (isCol(j) && search(pieceType, searchType, pos, (Position){ i, j }, piece, board, candidates, count, kingPos)) return true;
-            return false;
-        case PAWN:
-            isWhite = hasSameColor(piece, true);
-            for (int i = pos.row + 2 - isWhite * 4; i != pos.row; i -= 1 - isWhite * 2) {
-                if (!isRow(i)) continue;
-                for (int j = pos.col - 1; j <= pos.col + 1; ++j) {
-                    if (!isCol(j)) continue;
-                    const Position dest = { i, j };
-                    if (isKnightMove(dest, pos)) continue;
-                    if (search(pieceType, ISLEGALMOVE, pos, dest, piece, board, candidates, count, kingPos)) return true;
-                }
+// Fills the slider tables, indexing each square's slice with its magic number unless PEXT can index it directly
+void initializeMagics(Magic *const restrict magics, Bitboard *table, const Bitboard *const restrict magicNumbers, const bool diagonal) {
+    for (int square = 0; square < BOARD_SIZE * BOARD_SIZE; ++square) {
+        Magic *const magic = &magics[square];
+        const int row = square / BOARD_SIZE, col = square % BOARD_SIZE;
+        // Edge squares never block anything, unless the slider stands on that edge
+        const Bitboard edges = ((rowMask(0) | rowMask(7)) & ~rowMask(row)) | ((colMask(0) | colMask(7)) & ~colMask(col));
+        Bitboard subset = 0;
+        magic->mask = slidingAttacks(square, 0, diagonal) & ~edges;
+        magic->magic = magicNumbers[square];
+        magic->shift = BOARD_SIZE * BOARD_SIZE - popCount(magic->mask);
+        magic->attacks = table;
+        do {
+            magic->attacks[magicIndex(magic, subset)] = slidingAttacks(square, subset, diagonal);
+            subset = (subset - magic->mask) & magic->mask;
+        } while (subset);
+        table += (size_t)1 << popCount(magic->mask);
+    }
+}
+
+void initializeAttackTables(void) {
+    for (int square = 0; square < BOARD_SIZE * BOARD_SIZE; ++square) {
+        knightAttacks[square] = stepAttacks(square, knightOffsets, 8);
+        kingAttacks[square] = stepAttacks(square, kingOffsets, 8);
+        pawnAttacks[WHITE][square] = stepAttacks(square, pawnOffsets[WHITE], 2);
+        pawnAttacks[BLACK][square] = stepAttacks(square, pawnOffsets[BLACK], 2);
+    }
+    initializeMagics(rookMagics, rookTable, rookMagicNumbers, false);
+    initializeMagics(bishopMagics, bishopTable, bishopMagicNumbers, true);
+    for (int square1 = 0; square1 < BOARD_SIZE * BOARD_SIZE; ++square1)
+        for (int square2 = 0; square2 < BOARD_SIZE * BOARD_SIZE; ++square2)
+            for (int diagonal = 0; diagonal < 2; ++diagonal) {
+                if (square1 == square2 || !(slidingAttacks(square1, 0, diagonal) & bit(square2))) continue;
+                betweenSquares[square1][square2] = slidingAttacks(square1, bit(square2), diagonal) & slidingAttacks(square2, bit(square1), diagonal);
+                lineThrough[square1][square2] = (slidingAttacks(square1, 0, diagonal) & slidingAttacks(square2, 0, diagonal)) | bit(square1) | bit(square2);
             }
-            return false;
+}
+
+uint64_t randomNumber(uint64_t *const restrict seed) {
+    *seed ^= *seed >> 12;
+    *seed ^= *seed << 25;
+    *seed ^= *seed >> 27;
+    return *seed * 2685821657736338717ULL;
+}
+
+void initializeZobristKeys(void) {
+    uint64_t seed = 0x9E3779B97F4A7C15ULL;
+    for (int i = 0; i < 12; ++i) for (int square = 0; square < BOARD_SIZE * BOARD_SIZE; ++square) pieceKeys[i][square] = randomNumber(&seed);
+    // Each castling right gets its own key and every combination is the XOR of its rights
+    for (int i = 0; i < 4; ++i) castlingKeys[1 << i] = randomNumber(&seed);
+    for (int rights = 1; rights < 16; ++rights) castlingKeys[rights] = castlingKeys[rights & -rights] ^ castlingKeys[rights & (rights - 1)];
+    for (int col = 0; col < BOARD_SIZE; ++col) enPeasantKeys[col] = randomNumber(&seed);
+    sideKey = randomNumber(&seed);
+}
+
+// The en peasant file only changes the key if the side to move has a pawn that could capture
+uint64_t enPeasantKey(const Bitboards *const restrict bitboards, const int enPeasant, const bool isWhite) {
+    if (!enPeasant || !(pawnAttacks[sideOf(!isWhite)][enPeasant] & bitboards->pieces[sideOf(isWhite)][PAWNS])) return 0;
+    return enPeasantKeys[enPeasant % BOARD_SIZE];
+}
+
+uint64_t computeKey(const GameState *const restrict state) {
+    const bool isWhite = state->status != BLACK;
+    uint64_t key = castlingKeys[state->castlingRights] ^ enPeasantKey(&state->bitboards, state->enPeasant, isWhite) ^ (isWhite ? 0 : sideKey);
+    for (Bitboard pieces = state->bitboards.occupied; pieces; pieces &= pieces - 1) key ^= pieceKeys[state->bitboards.squares[lsb(pieces)]][lsb(pieces)];
+    return key;
+}
+
+Bitboard attacksFrom(const PieceSet set, const int square, const Bitboard occupied, const bool isWhite) {
+    switch (set) {
+        case PAWNS:
+            return pawnAttacks[sideOf(isWhite)][square];
+        case KNIGHTS:
+            return knightAttacks[square];
+        case BISHOPS:
+            return bishopAttacks(square, occupied);
+        case ROOKS:
+            return rookAttacks(square, occupied);
+        case QUEENS:
+            return bishopAttacks(square, occupied) | rookAttacks(square, occupied);
+        default:
+            return kingAttacks[square];
     }
 }
 
-bool canMoveTo(Board board, Position target, bool isWhite, KingPosition kingPos, const Move previousMove) {
-    // Checks for pawns that can move forward to block
-    for (int i = 1; i < 3; ++i) {
-        const short int row = target.row + i * (2 * isWhite - 1);
-        const char square = board[row][target.col];
-        if (square == 'p' - isWhite * 32 && isPossibleMove(board, (Move){ i == 1 ? NORMALMOVE : DOUBLEPAWNMOVE, { row, target.col }, target, square, false, ' ' }, &kingPos)) return true;
-        if (target.row != 3 + isWhite) break;
-    }
-    // Checks for pawns that can en peasant into that square
-    if (target.row == 5 - 3 * isWhite && previousMove.type == DOUBLEPAWNMOVE && previousMove.destination.col == target.col)
-        for (int i = target.row - 1; i <= target.row + 1; i += 2) {
-            if (!isCol(i)) continue;
-            const short int row = previousMove.destination.row;
-            const char square = board[row][i];
-            if (square != 'p' - 32 * isWhite) continue;
-            if (isPossibleMove(board, (Move){ ENPEASANT, { row, target.col }, target, square, true, ' ' }, &kingPos)) return true;
-        }
-    // Search for all other types of pieces
-    const int numberOfSearches = 4;
-    const PieceType pieceList[numberOfSearches] = { ROOK, KNIGHT, BISHOP, QUEEN };
-    for (int i = 0; i < numberOfSearches; ++i) {
-        Position candidates[8];
-        unsigned short int count = 0;
-        searchBoard(pieceList[i], FINDPIECES, target, pieceList[i] + 32 * !isWhite, board, candidates, &count, NULL);
-        for (unsigned short int j = 0; j < count; ++j) if (isPossibleMove(board, (Move){ NORMALMOVE, candidates[j], target, pieceList[i] + !isWhite * 32, false, ' ' }, &kingPos)) return true;
+// Every piece of the given color that attacks the square, sliders being blocked by the given occupancy
+Bitboard attackersTo(const Bitboards *const restrict bitboards, const int square, const Bitboard occupied, const bool byWhite) {
+    const Bitboard *const pieces = bitboards->pieces[sideOf(byWhite)];
+    return (pawnAttacks[sideOf(!byWhite)][square] & pieces[PAWNS])
+        | (knightAttacks[square] & pieces[KNIGHTS])
+        | (kingAttacks[square] & pieces[KINGS])
+        | (bishopAttacks(square, occupied) & (pieces[BISHOPS] | pieces[QUEENS]))
+        | (rookAttacks(square, occupied) & (pieces[ROOKS] | pieces[QUEENS]));
+}
+
+void addMove(MoveList *const restrict list, const MoveType type, const int origin, const int destination) {
+    list->moves[list->count++] = createMove(type, origin, destination);
+}
+
+// Finds the pieces giving check to the side to move and its pieces pinned to the king, once per position
+void updateCheckInfo(GameState *const restrict state) {
+    const Bitboards *const bitboards = &(state->bitboards);
+    const bool isWhite = state->status == WHITE;
+    const int side = sideOf(isWhite), kingSquare = lsb(bitboards->pieces[side][KINGS]);
+    const Bitboard *const enemy = bitboards->pieces[!side];
+    Bitboard snipers = (rookAttacks(kingSquare, 0) & (enemy[ROOKS] | enemy[QUEENS])) | (bishopAttacks(kingSquare, 0) & (enemy[BISHOPS] | enemy[QUEENS]));
+    isInCheck(bitboards, kingSquare, isWhite, &state->checkers);
+    state->pinned = 0;
+    // A slider that would see the king if exactly one own piece was not in the way pins that piece
+    for (; snipers; snipers &= snipers - 1) {
+        const Bitboard blockers = betweenSquares[kingSquare][lsb(snipers)] & bitboards->occupied;
+        if (popCount(blockers) == 1) state->pinned |= blockers & bitboards->occupancy[side];
     }
-    return false;
 }
 
-bool isCheckmate(Board board, KingPosition oppKingPos, Position *checkers, const short int checkerCount, const Move previousMove) {
-    const bool isWhite = hasSameColor(boardAt(oppKingPos), true);
-    if (!checkerCount) return false;
-    if (checkerCount == 1) {
-        Position saviors[16];
-        unsigned short int saviorCount = 0;
-        if (isInCheck(board, checkers[0], !isWhite, previousMove, saviors, &saviorCount)) for (int i = 0; i < saviorCount; ++i) if (isPossibleMove(board, (Move){ NORMALMOVE, saviors[i], checkers[0], boardAt(saviors[i]), true, ' ' }, &oppKingPos)) return false;
-        if (toupper(boardAt(checkers[0])) != KNIGHT) {
-            Position lineOfSight[6];
-            unsigned short int squareCount = 0;
-            if (!getLineOfSight(checkers[0], getRegPos(oppKingPos), lineOfSight, &squareCount)) return false;
-            for (int i = 0; i < squareCount; ++i) if (canMoveTo(board, lineOfSight[i], isWhite, oppKingPos, previousMove)) return false;
+// In check only the king may step aside or, if there is a single checker, a piece capture it or step in between. Those pieces are found backwards from the
+// checker and the squares in between, so no other piece is looked at. A pinned piece never helps, the line of its pin only meets the line of the check on the king
+SPECIALIZED void generateEvasionsFor(const GameState *const restrict state, MoveList *const restrict list, const bool firstOnly, const int side) {
+    const Bitboards *const bitboards = &(state->bitboards);
+    const bool isWhite = side == WHITE;
+    const int forward = isWhite ? -BOARD_SIZE : BOARD_SIZE, kingSquare = lsb(bitboards->pieces[side][KINGS]), checker = lsb(state->checkers);
+    const Bitboard occupied = bitboards->occupied, pawns = bitboards->pieces[side][PAWNS] & ~state->pinned;
+    const Bitboard defenders = bitboards->occupancy[side] & ~bitboards->pieces[side][KINGS] & ~state->pinned;
+    list->count = 0;
+    for (Bitboard targets = kingAttacks[kingSquare] & ~bitboards->occupancy[side]; targets && !(firstOnly && list->count); targets &= targets - 1)
+        if (!attackersTo(bitboards, lsb(targets), occupied ^ bit(kingSquare), !isWhite)) addMove(list, NORMALMOVE, kingSquare, lsb(targets));
+    if (popCount(state->checkers) > 1 || (firstOnly && list->count)) return;
+    for (Bitboard targets = state->checkers | betweenSquares[kingSquare][checker]; targets; targets &= targets - 1) {
+        const int destination = lsb(targets), row = destination / BOARD_SIZE;
+        Bitboard origins = attackersTo(bitboards, destination, occupied, isWhite) & defenders;
+        // Pawns capture only the checker and step onto the empty squares in between
+        if (destination != checker) {
+            origins &= ~pawns;
+            if (row != (isWhite ? 7 : 0) && (pawns & bit(destination - forward))) origins |= bit(destination - forward);
+            else if (row == (isWhite ? 4 : 3) && !(occupied & bit(destination - forward))) origins |= pawns & bit(destination - 2 * forward);
+        }
+        for (; origins; origins &= origins - 1) {
+            const int origin = lsb(origins);
+            if (!(pawns & bit(origin))) addMove(list, NORMALMOVE, origin, destination);
+            else if (row == (isWhite ? 0 : 7)) for (int set = QUEENS; set > PAWNS; --set) addMove(list, PROMOTION | set, origin, destination);
+            else addMove(list, abs(destination - origin) == 2 * BOARD_SIZE ? DOUBLEPAWNMOVE : NORMALMOVE, origin, destination);
+            if (firstOnly) return;
         }
     }
-    for (int i = oppKingPos.row - 1; i <= oppKingPos.row + 1; ++i)
-        for (int j = oppKingPos.col - 1; 0 <= i && i < BOARD_SIZE && j <= oppKingPos.col + 1; ++j)
-            if (0 <= j && j < BOARD_SIZE && isPossibleMove(board, (Move){ NORMALMOVE, getRegPos(oppKingPos), { i, j }, 'K' + 32 * !isWhite, false, ' ' }, &oppKingPos)) return false;
-    return true;
+    // Taking en peasant removes a checking pawn or blocks a slider on the square the pawn passed, which the board after the move tells apart
+    for (Bitboard origins = state->enPeasant ? pawnAttacks[!side][state->enPeasant] & pawns : 0; origins && !(firstOnly && list->count); origins &= origins - 1) {
+        const Move move = createMove(ENPEASANT, lsb(origins), state->enPeasant);
+        if (isPossibleMove(bitboards, move)) list->moves[list->count++] = move;
+    }
 }
 
-BoardPosition *convertBoardPosition(GameState *state) {
-    const char options[16] = { ' ', 'p', 'P', 'r', 'c', 'R', 'C', 'n', 'N', 'b', 'B', 'q', 'Q', 'k', 'K', 'e' };
-    const Position corners[4] = { { 0, 0 }, { 0, 7 }, { 7, 0 }, { 7, 7 } };
-    const bool castlingRights[4] = { state->blackKing.canCastleLong, state->blackKing.canCastleShort, state->whiteKing.canCastleLong, state->whiteKing.canCastleShort };
-    bool seenDest = false;
-    const Board board = state->board;
-    BoardPosition *const position = &(state->positions[state->movesWithoutCaptures++]);
-    for (int i = 0; i < BOARD_SIZE; ++i) for (int j = 0; j < BOARD_SIZE; j += 2) {
-        const Position pos[2] = { { i, j },  { i, j + 1 } };
-        char p[2] = { boardAt(pos[0]), boardAt(pos[1]) };
-        for (int k = 0; k < 15; ++k) for (int l = 0; l < 2; ++l) if (options[k] == p[l]) p[l] = k;
-        if (!seenDest) for (int k = 0; k < 2; ++k) {
-            if (!comparePositions(state->move.destination, pos[k])) continue;
-            if (state->move.type == DOUBLEPAWNMOVE) p[k] = 15;
-            seenDest = true;
-        }
-        (*position)[(i * BOARD_SIZE + j) / 2].p1 = p[0];
-        (*position)[(i * BOARD_SIZE + j) / 2].p2 = p[1];
+void generateEvasions(const GameState *const restrict state, MoveList *const restrict list, const bool firstOnly) {
+    if (state->status == WHITE) generateEvasionsFor(state, list, firstOnly, WHITE);
+    else generateEvasionsFor(state, list, firstOnly, BLACK);
+}
+
+// Only king moves and en peasant need to look at the board after the move, every other move is legal if it keeps to the line of its pin
+// Noisy moves are captures and promotions, quiet moves all others. Only pieces on the origins are moved
+SPECIALIZED void generateMovesFor(const GameState *const restrict state, MoveList *const restrict list, const int side, const bool noisy, const bool quiet, const Bitboard origins) {
+    const Bitboards *const bitboards = &(state->bitboards);
+    const bool isWhite = side == WHITE;
+    const int forward = isWhite ? -BOARD_SIZE : BOARD_SIZE, kingSquare = lsb(bitboards->pieces[side][KINGS]), castleSquare = isWhite ? 60 : 4;
+    const Bitboard enemy = bitboards->occupancy[!side], occupied = bitboards->occupied;
+    const Bitboard destinations = (noisy ? enemy : 0) | (quiet ? ~occupied : 0);
+    list->count = 0;
+    for (Bitboard targets = origins & bit(kingSquare) ? kingAttacks[kingSquare] & destinations : 0; targets; targets &= targets - 1)
+        if (!attackersTo(bitboards, lsb(targets), occupied ^ bit(kingSquare), !isWhite)) addMove(list, NORMALMOVE, kingSquare, lsb(targets));
+    for (Bitboard pawns = bitboards->pieces[side][PAWNS] & origins; pawns; pawns &= pawns - 1) {
+        const int origin = lsb(pawns), push = origin + forward;
+        const Bitboard allowed = state->pinned & bit(origin) ? lineThrough[kingSquare][origin] : ~(Bitboard)0;
+        Bitboard targets = noisy ? pawnAttacks[side][origin] & enemy : 0;
+        if (!(occupied & bit(push))) {
+            if (push / BOARD_SIZE == (isWhite ? 0 : 7) ? noisy : quiet) targets |= bit(push);
+            if (quiet && origin / BOARD_SIZE == (isWhite ? 6 : 1) && !(occupied & bit(push + forward)) && (allowed & bit(push + forward))) addMove(list, DOUBLEPAWNMOVE, origin, push + forward);
+        }
+        // En peasant takes two pieces off the same rank at once, which the pin mask can not see
+        if (noisy && state->enPeasant && (pawnAttacks[side][origin] & bit(state->enPeasant))) {
+            const Move move = createMove(ENPEASANT, origin, state->enPeasant);
+            if (isPossibleMove(bitboards, move)) list->moves[list->count++] = move;
+        }
+        for (targets &= allowed; targets; targets &= targets - 1) {
+            const int destination = lsb(targets);
+            if (destination / BOARD_SIZE != (isWhite ? 0 : 7)) {
+                addMove(list, NORMALMOVE, origin, destination);
+                continue;
+            }
+            for (int set = QUEENS; set > PAWNS; --set) addMove(list, PROMOTION | set, origin, destination);
+        }
     }
-    for (int i = 0; i < 4; ++i) {
-        PieceCouple * const pos = &((*position)[(corners[i].row * BOARD_SIZE + corners[i].col) / 2]);
-        const unsigned short int offset = i % 2;
-        const unsigned char c = offset == 0 ? pos->p1 : pos->p2;
-        if ((c != 3 || i != offset || !castlingRights[i]) && (c != 5 || i != 2 + offset || !castlingRights[i])) continue;
-        if (offset == 0) { ++pos->p1; } else ++pos->p2;
+    for (int set = KNIGHTS; set < KINGS; ++set)
+        for (Bitboard pieces = bitboards->pieces[side][set] & origins; pieces; pieces &= pieces - 1) {
+            const int origin = lsb(pieces);
+            Bitboard targets = attacksFrom(set, origin, occupied, isWhite) & destinations;
+            if (state->pinned & bit(origin)) targets &= lineThrough[kingSquare][origin];
+            for (; targets; targets &= targets - 1) addMove(list, NORMALMOVE, origin, lsb(targets));
+        }
+    // The king may neither castle through nor onto an attacked square
+    for (int type = CASTLESHORT; quiet && (origins & bit(kingSquare)) && type <= CASTLELONG; ++type) {
+        const bool isShort = type == CASTLESHORT;
+        const int rookSquare = castleSquare + (isShort ? 3 : -4), destination = castleSquare + (isShort ? 2 : -2);
+        if (!(state->castlingRights & (isShort ? WHITESHORT : WHITELONG) << 2 * !isWhite)) continue;
+        if (kingSquare != castleSquare || !(bitboards->pieces[side][ROOKS] & bit(rookSquare)) || (betweenSquares[castleSquare][rookSquare] & occupied)) continue;
+        if (attackersTo(bitboards, (castleSquare + destination) / 2, occupied, !isWhite) || attackersTo(bitboards, destination, occupied, !isWhite)) continue;
+        addMove(list, type, castleSquare, destination);
     }
-    return position;
 }
 
-bool compareBoardPositions(const BoardPosition * const restrict old, const BoardPosition * const restrict new) {
-    for (int i = 0; i < BOARD_SIZE * BOARD_SIZE / 2; ++i) {
-        if ((*old)[i].p1 != (*new)[i].p1) return false;
-        if ((*old)[i].p2 != (*new)[i].p2) return false;
-    }
-    return true;
+void generateLegalMoves(const GameState *const restrict state, MoveList *const restrict list) {
+    if (state->checkers) generateEvasions(state, list, false);
+    else if (state->status == WHITE) generateMovesFor(state, list, WHITE, true, true, ~(Bitboard)0);
+    else generateMovesFor(state, list, BLACK, true, true, ~(Bitboard)0);
+}
+
+// Only the kinds of moves asked for, for the staged move picker of the search. The side to move must not be in check
+void generateMoves(const GameState *const restrict state, MoveList *const restrict list, const bool noisy, const bool quiet, const Bitboard origins) {
+    if (state->status == WHITE) generateMovesFor(state, list, WHITE, noisy, quiet, origins);
+    else generateMovesFor(state, list, BLACK, noisy, quiet, origins);
 }
 
-void updateGameStatus(GameState *state, bool *isCheck) {
-    Position candidates[16];
+bool isCheckmate(const GameState *const restrict state) {
+    MoveList moves;
+    if (!state->checkers) return false;
+    generateEvasions(state, &moves, true);
+    return moves.count == 0;
+}
+
+// Counts how often the current position was reached before, only comparing positions with the same side to move since the last capture or pawn move
+unsigned short int countRepetitions(const GameState *const restrict state) {
     unsigned short int count = 0;
-    const Board board = state->board;
+    for (int i = 4; i <= state->movesWithoutCaptures && i <= state->plyCount; i += 2)
+        if (state->keyHistory[(state->plyCount - i) % HISTORY_SIZE] == state->key) ++count;
+    return count;
+}
+
+// Called after the move was made, so the status still holds the side to move unless the player offered a draw or resigned
+void updateGameStatus(GameState *state, LegalMoves *legal, bool *isCheck) {
+    const Bitboards *const bitboards = &(state->bitboards);
     GameStatus *status = &(state->status);
-    KingPosition *ownKingPos = *status == WHITE ? &(state->whiteKing) : &(state->blackKing);
-    const KingPosition oppKingPos = *status == BLACK ? state->whiteKing : state->blackKing;
-    const Move move = state->move;
-    const unsigned short int *movesWithoutCaptures = &(state->movesWithoutCaptures);
-    if (isInCheck(board, getRegPos(oppKingPos), *status == BLACK, move, candidates, &count)) {
-        *isCheck = true;
-        if (isCheckmate(board, oppKingPos, candidates, count, move)) {
-            *status = *status == WHITE ? WIN : LOSE;
-            return;
-        }
-    }
-    if (move.type == PLAYERDRAW) {
+    const bool isWhite = *status == WHITE;
+    if (moveType(state->move) == PLAYERDRAW) {
         *status = DRAWBYPLAYER;
         return;
-    } else if (*movesWithoutCaptures >= 100) {
-        *status = DRAWBY50MOVERULE;
-        return;
-    } else if (move.type == RESIGN) {
-        *status = *status == BLACK ? WIN : LOSE;
-        return;
-    }
-    if (tolower(move.pieceMoved) == 'r') {
-        switch (move.origin.col) {
-            case 7:
-                ownKingPos->canCastleShort = false;
-                break;
-            case 0:
-                ownKingPos->canCastleLong = false;
-        }
-    } else if (tolower(move.pieceMoved) == 'k') *ownKingPos = (KingPosition){
-        .row = move.destination.row,
-        .col = move.destination.col,
-    };
-    BoardPosition *currentPosition = convertBoardPosition(state);
-    count = 1;
-    for (int i = 0; i < *movesWithoutCaptures - 1 && count < 3; ++i)
-        if (compareBoardPositions(&(state->positions[i]), currentPosition)) ++count;
-    if (count == 3) {
-        *status = DRAWBYREPETITION;
+    } else if (moveType(state->move) == RESIGN) {
+        *status = isWhite ? LOSE : WIN;
         return;
     }
-    *status = *status == WHITE ? BLACK : WHITE;
-    if (!hasSufficientMaterial(board)) *status = DRAWBYMATERIAL;
-    if (isStalemate(board, oppKingPos)) *status = STALEMATE;
-}
-
-bool hasSufficientMaterial(const Board board) {
-    unsigned short int knightCount = 0, bishopCount[2] = {0};
-    for (int i = 0; i < BOARD_SIZE; ++i) for (int j = 0; j < BOARD_SIZE; ++j)
-        switch (toupper(board[i][j])) {
-            case ROOK:
-            case QUEEN:
-            case PAWN:
-                return true;
-            case KNIGHT:
-                ++knightCount;
-                break;
-            case BISHOP:
-                ++bishopCount[(i + j) % 2];
-        }
-    return (knightCount > 1 || (bishopCount[0] > 0 && bishopCount[1] > 0) || (bishopCount[0] + bishopCount[1] > 0 && knightCount > 0));
+    *isCheck = state->checkers != 0;
+    prepareLegalMoves(state, legal);
+    if (!legal->list.count) *status = *isCheck ? (isWhite ? LOSE : WIN) : STALEMATE;
+    else if (state->movesWithoutCaptures >= 100) *status = DRAWBY50MOVERULE;
+    else if (countRepetitions(state) >= 2) *status = DRAWBYREPETITION;
+    else if (!hasSufficientMaterial(bitboards)) *status = DRAWBYMATERIAL;
 }
 
-bool isStalemate(Board board, KingPosition kingPos) {
-    const bool isWhite = hasSameColor(boardAt(kingPos), true);
-    Position pieces[BOARD_SIZE * 2];
-    unsigned short int count = 0;
-    for (int i = 0; i < BOARD_SIZE; ++i) for (int j = 0; j < BOARD_SIZE; ++j) if (hasSameColor(board[i][j], isWhite)) pieces[count++] = (Position){i, j};
-    for (int i = 0; i < count; ++i) {
-        const char piece = boardAt(pieces[i]);
-        if (searchBoard(toupper(piece), ISLEGALMOVE, pieces[i], piece, board, NULL, NULL, &kingPos)) return false;
-    }
-    return true;
+bool hasSufficientMaterial(const Bitboards *const restrict bitboards) {
+    const Bitboard (*const pieces)[6] = bitboards->pieces;
+    if (pieces[WHITE][PAWNS] | pieces[BLACK][PAWNS] | pieces[WHITE][ROOKS] | pieces[BLACK][ROOKS] | pieces[WHITE][QUEENS] | pieces[BLACK][QUEENS]) return true;
+    const Bitboard knights = pieces[WHITE][KNIGHTS] | pieces[BLACK][KNIGHTS], bishops = pieces[WHITE][BISHOPS] | pieces[BLACK][BISHOPS];
+    return (popCount(knights) > 1 || ((bishops & LIGHT_SQUARES) && (bishops & ~LIGHT_SQUARES)) || (bishops && knights));
 }
 
-// The isWhite parameter gives the color of the victim side. Returns how many enemy pieces can see the target position. Does not return pawns that can move into that square and are on the same column.
-bool isInCheck(Board board, const Position pos, bool isWhite, const Move previousMove, Position *attackers, unsigned short int *attackerCount) {
-    // Checks for pawns including pawns that can en peasant
-    for (int i = 1; i >= 0; --i) {
-        for (int j = -1; j < 2; j += 2) {
-            if (pos.col + j < 0 || pos.col + j >= BOARD_SIZE) continue;
-            const int row = pos.row - (i * (2 * isWhite - 1));
-            if (board[row][pos.col + j] == 'P' + isWhite * 32) attackers[(*attackerCount)++] = (Position){row, pos.col + j};
-        }
-        if (previousMove.destination.row != pos.row
-            || previousMove.destination.col != pos.col
-            || previousMove.type != DOUBLEPAWNMOVE
-        ) break;
-    }
-    // Search for all other types of pieces
-    const int numberOfSearches = 5;
-    const PieceType pieceList[numberOfSearches] = { ROOK, KNIGHT, BISHOP, QUEEN, KING };
-    for (int i = 0; i < numberOfSearches; ++i) searchBoard(pieceList[i], FINDPIECES, pos, pieceList[i] + isWhite * 32, board, attackers, attackerCount, NULL);
-    return *attackerCount > 0;
-}
-
-// Checks if making a move would put the player who made the move in check.
-bool isPossibleMove(Board board, const Move move, const KingPosition *ownKingPos) {
-    if (move.destination.row == move.origin.row && move.destination.col == move.origin.col) return false;
-    const char destSquare = boardAt(move.destination);
-    const bool isWhite = hasSameColor(move.pieceMoved, true);
-    const MoveType type = move.type;
-    Position positions[4];
-    char pieces[4];
-    int locationCount = 0;
-    if (hasSameColor(destSquare, isWhite)) return false;
-    if (destSquare != ' ' && !move.captures) return false;
-    if (destSquare == ' ' && move.captures && type != ENPEASANT) return false;
-    if (toupper(move.pieceMoved) == PAWN && move.captures && move.origin.col == move.destination.col) return false;
-    if (type == CASTLELONG || type == CASTLESHORT) {
-        locationCount = 4;
-        const int cList[4] = { 4, 2 + 4 * (type == CASTLESHORT), 0 + 7 * (type == CASTLESHORT), 3 + 2 * (type == CASTLESHORT) };
-        const char pList[4] = { isWhite ? 'K' : 'k', ' ', isWhite ? 'R' : 'r', ' ' };
-        for (int i = 0; i < 4; ++i) {
-            positions[i].row = isWhite ? 7 : 0;
-            positions[i].col = cList[i];
-            pieces[1] = pList[i];
-        }
-    } else {
-        if (type == ENPEASANT) {
-            ++locationCount;
-            positions[2].row = move.destination.row - 1 + isWhite * 2;
-            positions[2].col = move.destination.col;
-            pieces[2] = 'P' + isWhite * 32;
-        }
-        locationCount += 2;
-        pieces[0] = move.pieceMoved;
-        positions[0] = move.origin;
-        positions[1] = move.destination;
-        pieces[1] = boardAt(move.destination);
-    }
-    if (tolower(move.pieceMoved) != 'n' && !hasClearSight(board, move.origin, move.destination)) return false;
-    makeMove(board, move);
-    Position problems[16];
-    unsigned short int count = 0;
-    isInCheck(board, tolower(move.pieceMoved) == 'k' ? move.destination : getRegPos(*ownKingPos), isWhite, move, problems, &count);
-    for (int i = 0; i < locationCount; ++i) boardAt(positions[i]) = pieces[i];
-    return !count;
+// The isWhite parameter gives the color of the victim side. Returns whether any enemy piece can see the square and stores all of them in attackers.
+bool isInCheck(const Bitboards *const restrict bitboards, const int square, const bool isWhite, Bitboard *const restrict attackers) {
+    *attackers = attackersTo(bitboards, square, bitboards->occupied, !isWhite);
+    return *attackers != 0;
+}
+
+// Checks if making a pseudo legal move would put the player who made the move in check.
+bool isPossibleMove(const Bitboards *const restrict bitboards, const Move move) {
+    const bool isWhite = bitboards->occupancy[WHITE] & bit(moveOrigin(move));
+    Bitboards after = *bitboards;
+    movePieces(&after, move);
+    return !attackersTo(&after, lsb(after.pieces[sideOf(isWhite)][KINGS]), after.occupied, !isWhite);
 }
 
-void makeMove(Board board, const Move move) {
-    boardAt(move.origin) = ' ';
-    boardAt(move.destination) = move.type == PROMOTION ? move.promotionPiece : move.pieceMoved;
-    switch (move.type) {
+// Moves the pieces of a move on the bitboards without touching the rest of the game state
+SPECIALIZED void movePiecesFor(Bitboards *const restrict bitboards, const Move move, const int side) {
+    const int origin = moveOrigin(move), destination = moveDestination(move), rook = side * 6 + ROOKS;
+    const int piece = isPromotion(move) ? side * 6 + (int)promotionSet(move) : bitboards->squares[origin];
+    removePiece(bitboards, origin);
+    removePiece(bitboards, destination);
+    setPiece(bitboards, piece, destination);
+    switch (moveType(move)) {
         case ENPEASANT:
-            board[move.destination.row - 1 + ((move.pieceMoved == 'P') * 2)][move.destination.col] = ' ';
+            removePiece(bitboards, destination + (side == WHITE ? BOARD_SIZE : -BOARD_SIZE));
             break;
         case CASTLELONG:
-            board[move.destination.row][0] = ' ';
-            board[move.destination.row][3] = move.pieceMoved == 'K' ? 'R' : 'r';
+            removePiece(bitboards, destination - 2);
+            setPiece(bitboards, rook, destination + 1);
             break;
         case CASTLESHORT:
-            board[move.destination.row][7] = ' ';
-            board[move.destination.row][5] = move.pieceMoved == 'K' ? 'R' : 'r';
+            removePiece(bitboards, destination + 1);
+            setPiece(bitboards, rook, destination - 1);
         default:
             break;
     }
 }
 
-bool setMoveToCastle(Move *move, const MoveType type, const KingPosition kingPos) {
-    if (type != CASTLESHORT && type != CASTLELONG) return false;
-    const bool isWhite = hasSameColor(move->pieceMoved, false);
-    if ((!kingPos.canCastleShort && type == CASTLESHORT) || (!kingPos.canCastleLong && type == CASTLELONG)) {
-        printf("%s can't castle %s anymore.\n", isWhite ? White : Black, type == CASTLESHORT ? "short" : "long");
-        return false;
-    }
-    *move = (Move){ type, { isWhite ? 7 : 0, 4 }, { isWhite ? 7 : 0, type == CASTLESHORT ? 6 : 2 }, 'k' - isWhite * 32, false, ' ' };
-    return true;
+void movePieces(Bitboards *const restrict bitboards, const Move move) {
+    if (bitboards->occupancy[WHITE] & bit(moveOrigin(move))) movePiecesFor(bitboards, move, WHITE);
+    else movePiecesFor(bitboards, move, BLACK);
 }
 
-bool validateMove(char *const restrict move, GameState *const restrict state, bool *const restrict specifyRow, bool *const restrict specifyCol) {
-    Move newMove;
-    Board board = state->board;
-    char piece = move[0];
-    unsigned short int destinationIndex;
-    bool shouldReturn = false, isWhite = state->status == WHITE;
-    KingPosition kingPos = state->status == WHITE ? state->whiteKing : state->blackKing;
-    if (piece == 'O') {
-        bool isShort = strcmp(move, "O-O") == 0 || strcmp(move, "O-O+") == 0 || strcmp(move, "O-O#") == 0;
-        bool isLong = strcmp(move, "O-O-O") == 0 || strcmp(move, "O-O-O+") == 0 || strcmp(move, "O-O-O#") == 0;
-        if (!isShort && !isLong) return false;
-        if ((isShort && !kingPos.canCastleShort) || (isLong && !kingPos.canCastleLong)) return false;
-        Position regKingPos = getRegPos(kingPos);
-        Position tmp[16];
-        unsigned short int tmpCount = 0;
-        for (int i = 0; i < 3; ++i) {
-            if (isInCheck(board, regKingPos, isWhite, state->move, tmp, &tmpCount)) return false;
-            regKingPos.col += isShort ? 1 : -1;
-        }
-        regKingPos.col -= isShort ? 3 : -3;
-        if (!hasClearSight(board, regKingPos, (Position){ kingPos.row, isShort ? 7 : 0 })) return false;
-        return setMoveToCastle(&(state->move), isShort ? CASTLESHORT : CASTLELONG, kingPos);
-    }
-    if (!findDestination(move, &newMove, &destinationIndex)) return false;
-    const char destSquare = boardAt(newMove.destination);
-    if (tolower(destSquare) == 'k') return false;
-    if (isWhite && strchr("PNRBQ", destSquare)) return false;
-    if (!isWhite && strchr("pnrbq", destSquare)) return false;
-    newMove.type = NORMALMOVE;
-    newMove.captures = false;
-    int captureIndex = 0;
-    for (; captureIndex < MAX_MOVE_SIZE; ++captureIndex) {
-        if (move[captureIndex] != 'x') continue;
-        if (captureIndex > 3) return false;
-        if (move[captureIndex + 1] - 'a' != newMove.destination.col) return false;
-        if ('8' - move[captureIndex + 2] != newMove.destination.row) return false;
-        newMove.captures = true;
-        break;
+// Plays a legal move and passes the turn, storing what unmakeMove needs to take it back in the undo record
+SPECIALIZED void makeMoveFor(GameState *const restrict state, const Move move, Undo *const restrict undo, const int side) {
+    Bitboards *const bitboards = &(state->bitboards);
+    const int origin = moveOrigin(move), destination = moveDestination(move);
+    const int piece = bitboards->squares[origin], rook = side * 6 + ROOKS;
+    const bool isWhite = side == WHITE;
+    const int captureSquare = moveType(move) == ENPEASANT ? destination + (isWhite ? BOARD_SIZE : -BOARD_SIZE) : destination;
+    const int captured = bitboards->occupied & bit(captureSquare) ? bitboards->squares[captureSquare] : -1;
+    *undo = (Undo){ state->move, captured, state->castlingRights, state->enPeasant, state->movesWithoutCaptures, state->key, state->checkers, state->pinned };
+    const int placed = isPromotion(move) ? side * 6 + (int)promotionSet(move) : piece;
+    PieceChanges changes = { { placed * 64 + destination }, { piece * 64 + origin }, 1, 1 };
+    uint64_t key = state->key ^ sideKey ^ castlingKeys[state->castlingRights] ^ enPeasantKey(bitboards, state->enPeasant, isWhite);
+    key ^= pieceKeys[piece][origin] ^ pieceKeys[placed][destination];
+    if (captured >= 0) {
+        key ^= pieceKeys[captured][captureSquare];
+        changes.removed[changes.removedCount++] = captured * 64 + captureSquare;
     }
-    if (isCol(piece)) {
-        newMove.pieceMoved = 'p' - isWhite * 32;
-        newMove.origin.col = piece - 'a';
-        int ogRow = newMove.destination.row - 1 + isWhite * 2;
-        if (ogRow < 1 || ogRow > 6) return false;
-        newMove.origin.row = ogRow;
-        if (isRow(move[1])) {
-            for (int i = 0; i < 2; ++i) {
-                char square = board[ogRow][newMove.destination.col];
-                if (square == newMove.pieceMoved) {
-                    newMove.origin.row = ogRow;
-                    if (i == 1) newMove.type = DOUBLEPAWNMOVE;
-                    break;
-                }
-                if (newMove.destination.row - isWhite != 3 || i == 1) return false;
-                ogRow += 2 * isWhite - 1;
-            }
-        } else if (captureIndex == 1) {
-            if (board[ogRow][newMove.origin.col] != newMove.pieceMoved) return false;
-            if (destSquare == ' ') {
-                if (state->move.destination.row != newMove.destination.row - 1 + isWhite * 2
-                    || state->move.destination.col != newMove.destination.col
-                    || state->move.type != DOUBLEPAWNMOVE
-                ) return false;
-                newMove.type = ENPEASANT;
-            }
-        } else return false;
-        int i = 1 + newMove.captures * 3;
-        if (move[i] == '=') {
-            if (newMove.destination.row != 7 - isWhite * 7) return false;
-            if (!strchr("RNBQ", move[++i])) return false;
-            newMove.type = PROMOTION;
-            newMove.promotionPiece = move[i] + !isWhite * 32;
-        }
-        if ((newMove.destination.row == 0 || newMove.destination.row == 7) && newMove.type != PROMOTION) return 20;
-    } else if (strchr("KNRBQ", piece)) {
-        piece += !isWhite ? 32 : 0;
-        newMove.pieceMoved = piece;
-        Position candidates[8];
-        unsigned short int candidateCount = 0;
-        searchBoard(toupper(piece), FINDPIECES, newMove.destination, piece, board, candidates, &candidateCount, NULL);
-        if (candidateCount > 1) {
-            Position newCandidates[8];
-            unsigned short int newCandidateCount = 0;
-            Move testMove = { newMove.type, {0}, newMove.destination, newMove.pieceMoved, newMove.captures, ' ' };
-            for (int i = 0; i < candidateCount; ++i) {
-                testMove.origin = candidates[i];
-                if (isPossibleMove(board, testMove, &kingPos)) newCandidates[newCandidateCount++] = testMove.origin;
-            }
-            if (newCandidateCount == 1) {
-                newMove.origin = newCandidates[0];
-                state->move = newMove;
-                shouldReturn = true;
-            } else if (newCandidateCount > 1) {
-                if (destinationIndex <= 1) return false;
-                candidateCount = 0;
-                if (isCol(move[1])) {
-                    for (int i = 0; i < newCandidateCount; ++i) {
-                        if (newCandidates[i].col == move[1] - 'a') {
-                            candidates[candidateCount++] = newCandidates[i];
-                            *specifyCol = true;
-                        }
-                    }
-                    if (candidateCount > 1) {
-                        if (!isRow(move[2])) return false;
-                        for (int i = 0; i < candidateCount; ++i) {
-                            if (candidates[i].row == move[2] - '1') {
-                                newMove.origin = candidates[i];
-                                *specifyRow = true;
-                                shouldReturn = true;
-                            }
-                        }
-                        if (!shouldReturn) return false;
-                    }
-                } else if (isRow(move[1])) {
-                    for (int i = 0; i < newCandidateCount; ++i) {
-                        if (newCandidates[i].row != move[1] - '1') continue;
-                        candidates[candidateCount++] = newCandidates[i];
-                        *specifyRow = true;
-                    }
-                    if (candidateCount > 1) return false;
-                    newMove.origin = candidates[0];
-                    shouldReturn = true;
-                } else return false;
-            }
+    if (moveType(move) == CASTLESHORT || moveType(move) == CASTLELONG) {
+        const int from = moveType(move) == CASTLESHORT ? destination + 1 : destination - 2, to = moveType(move) == CASTLESHORT ? destination - 1 : destination + 1;
+        key ^= pieceKeys[rook][from] ^ pieceKeys[rook][to];
+        changes.added[changes.addedCount++] = rook * 64 + to;
+        changes.removed[changes.removedCount++] = rook * 64 + from;
+    }
+    updateEvaluation(&state->evaluation, &changes);
+    movePiecesFor(bitboards, move, side);
+    state->castlingRights &= ~(castlingLoss[origin] | castlingLoss[destination]);
+    state->enPeasant = moveType(move) == DOUBLEPAWNMOVE ? (origin + destination) / 2 : 0;
+    state->movesWithoutCaptures = captured >= 0 || piece == side * 6 + PAWNS ? 0 : state->movesWithoutCaptures + 1;
+    state->key = key ^ castlingKeys[state->castlingRights] ^ enPeasantKey(bitboards, state->enPeasant, !isWhite);
+    state->keyHistory[++state->plyCount % HISTORY_SIZE] = state->key;
+    ++state->moveCounter;
+    state->move = move;
+    state->status = isWhite ? BLACK : WHITE;
+    updateCheckInfo(state);
+}
+
+void makeMove(GameState *const restrict state, const Move move, Undo *const restrict undo) {
+    if (state->bitboards.squares[moveOrigin(move)] < 6) makeMoveFor(state, move, undo, WHITE);
+    else makeMoveFor(state, move, undo, BLACK);
+}
+
+SPECIALIZED void unmakeMoveFor(GameState *const restrict state, const Undo *const restrict undo, const int side) {
+    Bitboards *const bitboards = &(state->bitboards);
+    const Move move = state->move;
+    const int origin = moveOrigin(move), destination = moveDestination(move), rook = side * 6 + ROOKS;
+    const int placed = bitboards->squares[destination], piece = isPromotion(move) ? side * 6 + PAWNS : placed, captured = undo->captured;
+    // The reverse of the changes makeMove made
+    PieceChanges changes = { { piece * 64 + origin }, { placed * 64 + destination }, 1, 1 };
+    setPiece(bitboards, piece, origin);
+    removePiece(bitboards, destination);
+    switch (moveType(move)) {
+        case ENPEASANT:
+            setPiece(bitboards, captured, destination + (side == WHITE ? BOARD_SIZE : -BOARD_SIZE));
+            changes.added[changes.addedCount++] = captured * 64 + destination + (side == WHITE ? BOARD_SIZE : -BOARD_SIZE);
+            break;
+        case CASTLELONG:
+            removePiece(bitboards, destination + 1);
+            setPiece(bitboards, rook, destination - 2);
+            changes.added[changes.addedCount++] = rook * 64 + destination - 2;
+            changes.removed[changes.removedCount++] = rook * 64 + destination + 1;
+            break;
+        case CASTLESHORT:
+            removePiece(bitboards, destination - 1);
+            setPiece(bitboards, rook, destination + 1);
+            changes.added[changes.addedCount++] = rook * 64 + destination + 1;
+            changes.removed[changes.removedCount++] = rook * 64 + destination - 1;
+            break;
+        default:
+            if (captured < 0) break;
+            setPiece(bitboards, captured, destination);
+            changes.added[changes.addedCount++] = captured * 64 + destination;
+    }
+    updateEvaluation(&state->evaluation, &changes);
+    state->move = undo->move;
+    state->castlingRights = undo->castlingRights;
+    state->enPeasant = undo->enPeasant;
+    state->movesWithoutCaptures = undo->movesWithoutCaptures;
+    state->key = undo->key;
+    state->checkers = undo->checkers;
+    state->pinned = undo->pinned;
+    state->status = side;
+    --state->plyCount;
+    --state->moveCounter;
+}
+
+void unmakeMove(GameState *const restrict state, const Undo *const restrict undo) {
+    if (state->bitboards.occupancy[WHITE] & bit(moveDestination(state->move))) unmakeMoveFor(state, undo, WHITE);
+    else unmakeMoveFor(state, undo, BLACK);
+}
+
+// Generates the legal moves of the position unless they are already there, together with the sanKey each of them is matched on
+void prepareLegalMoves(const GameState *const restrict state, LegalMoves *const restrict legal) {
+    const Bitboards *const bitboards = &(state->bitboards);
+    if (legal->key == state->key) return;
+    generateLegalMoves(state, &legal->list);
+    for (int i = 0; i < legal->list.count; ++i) {
+        const Move move = legal->list.moves[i];
+        const int origin = moveOrigin(move);
+        const MoveType type = moveType(move);
+        legal->sanKeys[i] = sanKey(bitboards->squares[origin] % 6, moveDestination(move), isCapture(bitboards, move), isPromotion(move) ? promotionSet(move) : 0, origin % BOARD_SIZE, origin / BOARD_SIZE, type == CASTLESHORT || type == CASTLELONG ? type - CASTLESHORT + 1 : 0);
+    }
+    legal->key = state->key;
+}
+
+// Reads the move in algebraic notation into the sanKey it must have and the bits it gives, which must match exactly one legal move
+bool validateMove(const char *const restrict move, const GameState *const restrict state, LegalMoves *const restrict legal, Move *const restrict newMove) {
+    uint32_t value, mask = ~(SAN_COL_MASK | SAN_ROW_MASK);
+    int length = strlen(move), i = 0, set = PAWNS, promotion = 0, matches = 0;
+    // Checks, mates and annotations such as "!?" are not part of the move itself
+    while (length > 0 && (isspace(move[length - 1]) || strchr("+#!?", move[length - 1]))) --length;
+    // Some programs write castling with zeros
+    if (length == 3 && (strncmp(move, "O-O", 3) == 0 || strncmp(move, "0-0", 3) == 0)) {
+        value = sanKey(0, 0, 0, 0, 0, 0, 1);
+        mask = SAN_CASTLE_MASK;
+    } else if (length == 5 && (strncmp(move, "O-O-O", 5) == 0 || strncmp(move, "0-0-0", 5) == 0)) {
+        value = sanKey(0, 0, 0, 0, 0, 0, 2);
+        mask = SAN_CASTLE_MASK;
+    } else {
+        bool captures = false;
+        if (length > 0 && strchr("KNRBQ", move[0])) set = pieceIndex(move[i++]);
+        if (length - i > 2 && move[length - 2] == '=') {
+            if (set != PAWNS || !strchr("NBRQ", move[length - 1])) return false;
+            promotion = pieceIndex(move[length - 1]);
+            length -= 2;
+        }
+        if (length - i < 2 || !isCol(move[length - 2]) || !isRow(move[length - 1])) return false;
+        const int destination = ('8' - move[length - 1]) * BOARD_SIZE + move[length - 2] - 'a';
+        length -= 2;
+        if (length > i && move[length - 1] == 'x') {
+            captures = true;
+            --length;
         }
-        if (!shouldReturn && candidateCount == 1) {
-            newMove.origin = candidates[0];
-        } else if (!shouldReturn) return false;
-    } else return false;
-    if (!shouldReturn && !isPossibleMove(board, newMove, &kingPos)) return false;
-    if (newMove.captures || toupper(newMove.pieceMoved) == PAWN) state->movesWithoutCaptures = 0;
-    state->move = newMove;
+        value = sanKey(set, destination, captures, promotion, 0, 0, 0);
+        if (length > i && isCol(move[i])) {
+            value |= sanKey(0, 0, 0, 0, move[i++] - 'a', 0, 0);
+            mask |= SAN_COL_MASK;
+        }
+        if (length > i && isRow(move[i])) {
+            value |= sanKey(0, 0, 0, 0, 0, '8' - move[i++], 0);
+            mask |= SAN_ROW_MASK;
+        }
+        if (i != length) return false;
+        if (set == PAWNS && (captures != ((mask & SAN_COL_MASK) != 0) || (mask & SAN_ROW_MASK))) return false;
+    }
+    prepareLegalMoves(state, legal);
+    for (i = 0; i < legal->list.count; ++i) {
+        if ((legal->sanKeys[i] & mask) != value) continue;
+        *newMove = legal->list.moves[i];
+        ++matches;
+    }
+    return matches == 1;
+}
+
+// Allocates a table of the largest power of two clusters that fits into the given size, aligned so the kernel can back it with huge pages
+bool resizeTable(const long megabytes) {
+    size_t clusterCount = 1;
+    void *clusters = NULL;
+    if (megabytes < 1 || megabytes > MAX_HASH_SIZE || (size_t)megabytes > SIZE_MAX >> 20) return false;
+    const size_t clusterLimit = ((size_t)megabytes << 20) / sizeof(Cluster);
+    while (clusterCount <= clusterLimit / 2) clusterCount *= 2;
+    const size_t size = clusterCount * sizeof(Cluster);
+    if (posix_memalign(&clusters, size >= HUGE_PAGE_SIZE ? HUGE_PAGE_SIZE : sizeof(Cluster), size)) return false;
+#ifdef MADV_HUGEPAGE
+    madvise(clusters, size, MADV_HUGEPAGE);
+#endif
+    memset(clusters, 0, size);
+    free(transpositionTable.clusters);
+    transpositionTable = (TranspositionTable){ clusters, clusterCount - 1, 0 };
     return true;
 }
 
-bool findDestination(char *const restrict rawMove, Move *const restrict move, unsigned short int *const restrict destinationIndex) {
-    for (int i = 2; i < MAX_MOVE_SIZE; ++i) {
-        if (isalnum(rawMove[i])) continue;
-        if (!isRow(rawMove[--i])) return false;
-        if (!isCol(rawMove[--i])) return false;
-        *destinationIndex = i;
-        move->destination.col = rawMove[i] - 'a';
-        move->destination.row = '8' - rawMove[++i];
+// Reads every entry of the cluster once, so a concurrent writer can at worst make the lookup miss
+bool probeTable(const uint64_t key, uint64_t *const restrict data) {
+    if (!transpositionTable.clusters) return false;
+    const TableEntry *const entries = transpositionTable.clusters[key & transpositionTable.mask].entries;
+    for (int i = 0; i < CLUSTER_SIZE; ++i) {
+        const TableEntry entry = entries[i];
+        if ((entry.check ^ entry.data) != key) continue;
+        *data = entry.data;
+        return true;
+    }
+    return false;
+}
+
+// Overwrites the entry of the same position or else the one with the lowest depth, where every search since an entry was written counts as 8 plies less
+void storeTable(const uint64_t key, Move move, const int score, const int depth, const Bound bound) {
+    if (!transpositionTable.clusters) return;
+    TableEntry *const entries = transpositionTable.clusters[key & transpositionTable.mask].entries;
+    TableEntry *replace = entries;
+    int lowest = INFINITE_SCORE;
+    for (int i = 0; i < CLUSTER_SIZE; ++i) {
+        const TableEntry entry = entries[i];
+        if ((entry.check ^ entry.data) == key) {
+            if (!move) move = entryMove(entry.data);
+            replace = &entries[i];
+            break;
+        }
+        const int value = entryDepth(entry.data) - 8 * (unsigned char)(transpositionTable.generation - entryGeneration(entry.data));
+        if (value >= lowest) continue;
+        lowest = value;
+        replace = &entries[i];
+    }
+    const uint64_t data = packEntry(move, score, depth, bound, transpositionTable.generation);
+    *replace = (TableEntry){ key ^ data, data };
+}
+
+void initializeEvaluation(void) {
+    for (int piece = 0; piece < 12; ++piece)
+        for (int square = 0; square < BOARD_SIZE * BOARD_SIZE; ++square)
+            for (int phase = 0; phase < 2; ++phase) {
+                const int set = piece % 6, value = pieceValues[set] + pieceSquareTables[set == KINGS && phase ? KINGS + 1 : set][piece < 6 ? square : square ^ 56];
+                pieceSquareValues[phase][piece * 64 + square] = piece < 6 ? value : -value;
+            }
+}
+
+// Reads NETWORK_MAGIC followed by every weight of the Network in order, as 16 bit little endian numbers
+bool loadNetwork(const char *const restrict fileName) {
+    const size_t size = sizeof(NETWORK_MAGIC) - 1 + 2 * NETWORK_WEIGHT_COUNT;
+    Network *loaded = NULL;
+    FILE *const file = fopen(fileName, "rb");
+    if (!file) return false;
+    unsigned char *const bytes = malloc(size + 1);
+    const bool isValid = bytes && fread(bytes, 1, size + 1, file) == size && memcmp(bytes, NETWORK_MAGIC, sizeof(NETWORK_MAGIC) - 1) == 0 && !posix_memalign((void **)&loaded, 64, sizeof(Network));
+    fclose(file);
+    if (isValid) for (size_t i = 0; i < NETWORK_WEIGHT_COUNT; ++i) ((int16_t *)loaded)[i] = (int16_t)readBytes(bytes + sizeof(NETWORK_MAGIC) - 1 + 2 * i, 2);
+    free(bytes);
+    if (!isValid) return false;
+    free(network);
+    network = loaded;
+    return true;
+}
+
+// Small random weights, which evaluate as fast as trained ones
+bool randomizeNetwork(void) {
+    uint64_t seed = 0x5851F42D4C957F2DULL;
+    Network *loaded = NULL;
+    if (posix_memalign((void **)&loaded, 64, sizeof(Network))) return false;
+    for (size_t i = 0; i < NETWORK_WEIGHT_COUNT; ++i) ((int16_t *)loaded)[i] = (int16_t)(randomNumber(&seed) % 129) - 64;
+    free(network);
+    network = loaded;
+    return true;
+}
+
+// Adds the weights of the added inputs to the hidden layer of one side and subtracts those of the removed ones in one pass
+void updateAccumulator(int16_t *const restrict accumulator, const int *const restrict added, const int addedCount, const int *const restrict removed, const int removedCount) {
+    for (int i = 0; i < NETWORK_SIZE; i += SIMD_LANES) {
+        Lanes lanes = loadLanes(&accumulator[i]);
+        for (int j = 0; j < addedCount; ++j) lanes = addLanes(lanes, loadLanes(&network->featureWeights[added[j]][i]));
+        for (int j = 0; j < removedCount; ++j) lanes = subtractLanes(lanes, loadLanes(&network->featureWeights[removed[j]][i]));
+        storeLanes(&accumulator[i], lanes);
+    }
+}
+
+void updateEvaluation(Evaluation *const restrict evaluation, const PieceChanges *const restrict changes) {
+    for (int phase = 0; phase < 2; ++phase) {
+        for (int i = 0; i < changes->addedCount; ++i) evaluation->pieceSquare[phase] += pieceSquareValues[phase][changes->added[i]];
+        for (int i = 0; i < changes->removedCount; ++i) evaluation->pieceSquare[phase] -= pieceSquareValues[phase][changes->removed[i]];
+    }
+    if (!network) return;
+    for (int perspective = WHITE; perspective <= BLACK; ++perspective) {
+        int added[2], removed[2];
+        for (int i = 0; i < changes->addedCount; ++i) added[i] = networkFeature(perspective, changes->added[i]);
+        for (int i = 0; i < changes->removedCount; ++i) removed[i] = networkFeature(perspective, changes->removed[i]);
+        updateAccumulator(evaluation->accumulator[perspective], added, changes->addedCount, removed, changes->removedCount);
+    }
+}
+
+// Sets the evaluation up from scratch, which the search does once for its root and makeMove keeps up to date from there
+void refreshEvaluation(GameState *const restrict state) {
+    Evaluation *const evaluation = &(state->evaluation);
+    int features[2][BOARD_SIZE * BOARD_SIZE], count = 0;
+    evaluation->pieceSquare[0] = evaluation->pieceSquare[1] = 0;
+    for (Bitboard pieces = state->bitboards.occupied; pieces; pieces &= pieces - 1, ++count) {
+        const int pieceSquare = state->bitboards.squares[lsb(pieces)] * 64 + lsb(pieces);
+        for (int phase = 0; phase < 2; ++phase) evaluation->pieceSquare[phase] += pieceSquareValues[phase][pieceSquare];
+        features[WHITE][count] = networkFeature(WHITE, pieceSquare);
+        features[BLACK][count] = networkFeature(BLACK, pieceSquare);
+    }
+    if (!network) return;
+    for (int perspective = WHITE; perspective <= BLACK; ++perspective) {
+        memcpy(evaluation->accumulator[perspective], network->featureBiases, sizeof(network->featureBiases));
+        updateAccumulator(evaluation->accumulator[perspective], features[perspective], count, NULL, 0);
+    }
+}
+
+// Material and piece-square score from the point of view of the side to move, the king switches to its endgame table once the queens are gone
+int evaluateClassical(const GameState *const restrict state) {
+    const bool isEndgame = !(state->bitboards.pieces[WHITE][QUEENS] | state->bitboards.pieces[BLACK][QUEENS]);
+    return state->status == WHITE ? state->evaluation.pieceSquare[isEndgame] : -state->evaluation.pieceSquare[isEndgame];
+}
+
+// The hidden layer of one side, clipped to between 0 and 1, times the output weights
+int clippedDot(const int16_t *const restrict accumulator, const int16_t *const restrict weights) {
+    Lanes sum = zeroLanes();
+    for (int i = 0; i < NETWORK_SIZE; i += SIMD_LANES) sum = multiplyAddLanes(sum, clipLanes(loadLanes(&accumulator[i])), loadLanes(&weights[i]));
+    return sumLanes(sum);
+}
+
+// Score of the network from the point of view of the side to move, kept below the scores of won bitbase positions
+int evaluateNetwork(const GameState *const restrict state) {
+    const int side = state->status == WHITE ? WHITE : BLACK;
+    const int64_t output = (int64_t)clippedDot(state->evaluation.accumulator[side], network->outputWeights[0]) + clippedDot(state->evaluation.accumulator[!side], network->outputWeights[1]) + network->outputBias;
+    const int64_t score = output * NETWORK_SCALE / (NETWORK_QA * NETWORK_QB);
+    return score >= KNOWN_WIN_SCORE ? KNOWN_WIN_SCORE - 1 : score <= -KNOWN_WIN_SCORE ? 1 - KNOWN_WIN_SCORE : (int)score;
+}
+
+// The network's score if one is loaded and the classical one if not, unless the bitbases know the result
+int evaluate(const GameState *const restrict state) {
+    const Bitboards *const bitboards = &(state->bitboards);
+    int score, result;
+    // A won ending scores below the mates, better the further the winning side has got so the search keeps making progress
+    if (canProbeBitbase(state) && probeBitbase(bitboards, state->status == WHITE, &result)) {
+        if (!result) return 0;
+        score = KNOWN_WIN_SCORE + mopUp(bitboards, (result > 0) == (state->status == WHITE));
+        return result > 0 ? score : -score;
+    }
+    return network ? evaluateNetwork(state) : evaluateClassical(state);
+}
+
+// What the capture wins if both sides keep recapturing on its square with their least valuable attacker for as long as that pays, pins aside
+int staticExchange(const Bitboards *const restrict bitboards, const Move move) {
+    const int origin = moveOrigin(move), destination = moveDestination(move);
+    int gains[32], count = 0, side = bitboards->occupancy[WHITE] & bit(origin) ? WHITE : BLACK;
+    int attacker = isPromotion(move) ? (int)promotionSet(move) : bitboards->squares[origin] % 6;
+    Bitboard occupied = bitboards->occupied ^ bit(origin);
+    gains[0] = moveType(move) == ENPEASANT ? pieceValues[PAWNS] : bitboards->occupied & bit(destination) ? pieceValues[bitboards->squares[destination] % 6] : 0;
+    if (isPromotion(move)) gains[0] += pieceValues[attacker] - pieceValues[PAWNS];
+    if (moveType(move) == ENPEASANT) occupied ^= bit(destination + (side == WHITE ? BOARD_SIZE : -BOARD_SIZE));
+    while (count < 31) {
+        // Taking the piece off the board reveals the sliders behind it
+        const Bitboard attackers = (attackersTo(bitboards, destination, occupied, true) | attackersTo(bitboards, destination, occupied, false)) & occupied;
+        const Bitboard own = attackers & bitboards->occupancy[side = !side];
+        int set = PAWNS;
+        if (!own) break;
+        while (!(own & bitboards->pieces[side][set])) ++set;
+        // The king can only take a piece nothing defends any more
+        if (set == KINGS && (attackers & bitboards->occupancy[!side])) break;
+        ++count;
+        gains[count] = pieceValues[attacker] - gains[count - 1];
+        occupied ^= bit(lsb(own & bitboards->pieces[side][set]));
+        attacker = set;
+    }
+    // Each side stops recapturing where going on would lose
+    for (; count > 0; --count) if (gains[count] > -gains[count - 1]) gains[count - 1] = -gains[count];
+    return gains[0];
+}
+
+// Whether a move remembered from another position, from the table or a killer slot, is legal in this one. Only used when not in check
+bool isLegalMove(const GameState *const restrict state, const Move move) {
+    MoveList moves;
+    if (!move || !(state->bitboards.occupancy[state->status == WHITE ? WHITE : BLACK] & bit(moveOrigin(move)))) return false;
+    generateMoves(state, &moves, true, true, bit(moveOrigin(move)));
+    for (int i = 0; i < moves.count; ++i) if (moves.moves[i] == move) return true;
+    return false;
+}
+
+// Most valuable victim first and among those the least valuable attacker, promotions counting as winning the new piece
+int captureScore(const Bitboards *const restrict bitboards, const Move move) {
+    const int victim = moveType(move) == ENPEASANT ? PAWNS : bitboards->occupied & bit(moveDestination(move)) ? bitboards->squares[moveDestination(move)] % 6 : -1;
+    return (victim < 0 ? 0 : pieceValues[victim] * 8 - bitboards->squares[moveOrigin(move)] % 6) + (isPromotion(move) ? pieceValues[promotionSet(move)] : 0);
+}
+
+void startPicker(MovePicker *const restrict picker, const GameState *const restrict state, const Search *const restrict search, const Move tableMove, const int ply, const bool capturesOnly) {
+    picker->stage = state->checkers ? EVASIONGENERATION : TABLEMOVE;
+    picker->capturesOnly = capturesOnly;
+    picker->tableMove = tableMove;
+    picker->killers[0] = capturesOnly ? 0 : search->killers[ply][0];
+    picker->killers[1] = capturesOnly ? 0 : search->killers[ply][1];
+    picker->killerIndex = picker->badCount = picker->badNext = 0;
+    picker->history = search->history[state->status == WHITE ? WHITE : BLACK];
+}
+
+// Selection sort, one step at a time: moves the best of the moves not handed out yet to the front and hands it out
+Move selectBest(MovePicker *const restrict picker) {
+    int best = picker->next;
+    for (int i = picker->next + 1; i < picker->moves.count; ++i) if (picker->scores[i] > picker->scores[best]) best = i;
+    const Move move = picker->moves.moves[best];
+    const int score = picker->scores[best];
+    picker->moves.moves[best] = picker->moves.moves[picker->next];
+    picker->scores[best] = picker->scores[picker->next];
+    picker->moves.moves[picker->next] = move;
+    picker->scores[picker->next++] = score;
+    return move;
+}
+
+// The next move to search, or 0 once every move was handed out
+Move pickMove(MovePicker *const restrict picker, const GameState *const restrict state) {
+    const Bitboards *const bitboards = &(state->bitboards);
+    while (true) {
+        switch (picker->stage) {
+            case TABLEMOVE:
+                picker->stage = CAPTUREGENERATION;
+                if (isLegalMove(state, picker->tableMove) && (!picker->capturesOnly || isCapture(bitboards, picker->tableMove) || isPromotion(picker->tableMove))) return picker->tableMove;
+                picker->tableMove = 0;
+                break;
+            case CAPTUREGENERATION:
+                generateMoves(state, &picker->moves, true, false, ~(Bitboard)0);
+                for (int i = 0; i < picker->moves.count; ++i) picker->scores[i] = captureScore(bitboards, picker->moves.moves[i]);
+                picker->next = 0;
+                picker->stage = GOODCAPTURES;
+                break;
+            case GOODCAPTURES:
+                while (picker->next < picker->moves.count) {
+                    const Move move = selectBest(picker);
+                    if (move == picker->tableMove) continue;
+                    // Only captures of a piece worth less than the capturing one can lose material
+                    const bool isLosing = isPromotion(move) ? promotionSet(move) != QUEENS : pieceValues[bitboards->squares[moveDestination(move)] % 6] < pieceValues[bitboards->squares[moveOrigin(move)] % 6] && moveType(move) != ENPEASANT && staticExchange(bitboards, move) < 0;
+                    if (!isLosing) return move;
+                    picker->badCaptures[picker->badCount++] = move;
+                }
+                picker->stage = picker->capturesOnly ? NOMOREMOVES : KILLERMOVES;
+                break;
+            case KILLERMOVES:
+                while (picker->killerIndex < 2) {
+                    const Move move = picker->killers[picker->killerIndex++];
+                    if (move != picker->tableMove && !isCapture(bitboards, move) && !isPromotion(move) && isLegalMove(state, move)) return move;
+                }
+                picker->stage = QUIETGENERATION;
+                break;
+            case QUIETGENERATION:
+                generateMoves(state, &picker->moves, false, true, ~(Bitboard)0);
+                for (int i = 0; i < picker->moves.count; ++i) picker->scores[i] = picker->history[moveOrigin(picker->moves.moves[i])][moveDestination(picker->moves.moves[i])];
+                picker->next = 0;
+                picker->stage = QUIETMOVES;
+                break;
+            case QUIETMOVES:
+                while (picker->next < picker->moves.count) {
+                    const Move move = selectBest(picker);
+                    if (move != picker->tableMove && move != picker->killers[0] && move != picker->killers[1]) return move;
+                }
+                picker->stage = BADCAPTURES;
+                break;
+            case BADCAPTURES:
+                if (picker->badNext < picker->badCount) return picker->badCaptures[picker->badNext++];
+                picker->stage = NOMOREMOVES;
+                break;
+            // There are few evasions, so they are generated at once and the table move is only sorted to the front
+            case EVASIONGENERATION:
+                generateEvasions(state, &picker->moves, false);
+                for (int i = 0; i < picker->moves.count; ++i) {
+                    const Move move = picker->moves.moves[i];
+                    picker->scores[i] = move == picker->tableMove ? INFINITE_SCORE * 16 : isCapture(bitboards, move) || isPromotion(move) ? INFINITE_SCORE + captureScore(bitboards, move) : picker->history[moveOrigin(move)][moveDestination(move)];
+                }
+                picker->next = 0;
+                picker->stage = EVASIONS;
+                break;
+            case EVASIONS:
+                if (picker->next < picker->moves.count) return selectBest(picker);
+                picker->stage = NOMOREMOVES;
+                break;
+            default:
+                return 0;
+        }
+    }
+}
+
+// Moves the score towards the bonus by how far it still is from the limit, so it stays within HISTORY_LIMIT however often the move cuts off
+void addHistory(int *const restrict entry, const int bonus) {
+    *entry += bonus - *entry * abs(bonus) / HISTORY_LIMIT;
+}
+
+// A quiet move caused a beta cutoff: it becomes a killer of the ply and gains history, while the quiet moves tried before it lose some
+void rewardQuietMove(Search *const restrict search, const GameState *const restrict state, const Move move, const Move *const restrict tried, const int triedCount, const int depth, const int ply) {
+    int (*const history)[BOARD_SIZE * BOARD_SIZE] = search->history[state->status == WHITE ? WHITE : BLACK];
+    const int bonus = depth * depth < 400 ? depth * depth : 400;
+    if (search->killers[ply][0] != move) {
+        search->killers[ply][1] = search->killers[ply][0];
+        search->killers[ply][0] = move;
+    }
+    addHistory(&history[moveOrigin(move)][moveDestination(move)], bonus);
+    for (int i = 0; i < triedCount; ++i) addHistory(&history[moveOrigin(tried[i])][moveDestination(tried[i])], -bonus);
+}
+
+// Counts the node and tells whether to stop. Only the main thread checks the limits, reading the clock every 1024 nodes, and raises the
+// shared stop flag for the helpers once one is hit; its first iteration always finishes so there is a move to play
+bool checkLimits(Search *const restrict search) {
+    ++search->nodes;
+    if (search->stopped || (!search->id && !search->completedDepth)) return search->stopped;
+    if (stopSearch) search->stopped = true;
+    else if (!search->id) {
+        if (search->limits.nodes && search->nodes >= search->limits.nodes) search->stopped = true;
+        if (search->limits.moveTime && !(search->nodes & 1023) && elapsedSeconds(&search->start) * 1000 >= search->limits.moveTime) search->stopped = true;
+        if (search->stopped) stopSearch = true;
+    }
+    return search->stopped;
+}
+
+bool isSearchDraw(const GameState *const restrict state) {
+    return state->movesWithoutCaptures >= 100 || countRepetitions(state) > 0 || !hasSufficientMaterial(&state->bitboards);
+}
+
+// Only follows the captures and queen promotions that do not lose material, or every evasion when in check, until the position is quiet
+int quiescence(GameState *const restrict state, Search *const restrict search, int alpha, const int beta, const int ply) {
+    MovePicker picker;
+    Undo undo;
+    search->pvLength[ply] = 0;
+    if (checkLimits(search)) return 0;
+    if (ply >= MAX_PLY - 1) return evaluate(state);
+    int best = state->checkers ? -MATE_SCORE + ply : evaluate(state);
+    if (best >= beta) return best;
+    if (best > alpha) alpha = best;
+    startPicker(&picker, state, search, 0, ply, true);
+    for (Move move; (move = pickMove(&picker, state));) {
+        makeMove(state, move, &undo);
+        const int score = -quiescence(state, search, -beta, -alpha, ply + 1);
+        unmakeMove(state, &undo);
+        if (search->stopped) return 0;
+        if (score <= best) continue;
+        best = score;
+        if (score <= alpha) continue;
+        alpha = score;
+        if (alpha >= beta) break;
+    }
+    return best;
+}
+
+// Principal variation search: every move after the first is tried with a null window and only searched again if it turns out better
+int alphaBeta(GameState *const restrict state, Search *const restrict search, int alpha, const int beta, const int depth, const int ply) {
+    MovePicker picker;
+    Undo undo;
+    Move bestMove = 0, quiets[MAX_MOVES];
+    int moveCount = 0, quietCount = 0;
+    uint64_t data;
+    int result;
+    const int originalAlpha = alpha;
+    if (depth <= 0) return quiescence(state, search, alpha, beta, ply);
+    search->pvLength[ply] = 0;
+    if (checkLimits(search)) return 0;
+    if (ply && isSearchDraw(state)) return 0;
+    // Drawn endings need no search, won ones are searched on until evaluate scores them
+    if (ply && canProbeBitbase(state) && probeBitbase(&state->bitboards, state->status == WHITE, &result) && !result) return 0;
+    if (ply >= MAX_PLY - 1) return evaluate(state);
+    const bool hasEntry = probeTable(state->key, &data);
+    // Outside the principal variation a deep enough entry whose bound already decides the window ends the search
+    if (hasEntry && beta - alpha == 1 && (int)entryDepth(data) >= depth) {
+        const int score = scoreFromTable(entryScore(data), ply);
+        const Bound bound = entryBound(data);
+        if (bound == EXACTBOUND || (bound == LOWERBOUND && score >= beta) || (bound == UPPERBOUND && score <= alpha)) return score;
+    }
+    const bool followPV = search->followPV && ply < search->previousLength;
+    startPicker(&picker, state, search, followPV ? search->previousPV[ply] : hasEntry ? entryMove(data) : 0, ply, false);
+    int best = -INFINITE_SCORE;
+    for (Move move; (move = pickMove(&picker, state));) {
+        const bool isQuiet = !isCapture(&state->bitboards, move) && !isPromotion(move);
+        int score;
+        search->followPV = followPV && moveCount == 0 && move == search->previousPV[ply];
+        makeMove(state, move, &undo);
+        // Checks are searched one ply deeper so forcing lines are not cut off at the horizon
+        const int newDepth = depth - 1 + (state->checkers != 0);
+        if (moveCount == 0) score = -alphaBeta(state, search, -beta, -alpha, newDepth, ply + 1);
+        else {
+            score = -alphaBeta(state, search, -alpha - 1, -alpha, newDepth, ply + 1);
+            if (score > alpha && score < beta) score = -alphaBeta(state, search, -beta, -alpha, newDepth, ply + 1);
+        }
+        unmakeMove(state, &undo);
+        ++moveCount;
+        if (search->stopped) return 0;
+        if (score > best) {
+            best = score;
+            bestMove = move;
+        }
+        if (score > alpha) {
+            alpha = score;
+            search->pv[ply][0] = move;
+            memcpy(&search->pv[ply][1], search->pv[ply + 1], search->pvLength[ply + 1] * sizeof(Move));
+            search->pvLength[ply] = search->pvLength[ply + 1] + 1;
+        }
+        if (alpha >= beta) {
+            ++search->cutoffs;
+            search->firstMoveCutoffs += moveCount == 1;
+            if (isQuiet) rewardQuietMove(search, state, move, quiets, quietCount, depth, ply);
+            break;
+        }
+        if (isQuiet) quiets[quietCount++] = move;
+    }
+    if (!moveCount) return state->checkers ? -MATE_SCORE + ply : 0;
+    storeTable(state->key, best > originalAlpha ? bestMove : 0, scoreToTable(best, ply), depth, best >= beta ? LOWERBOUND : best > originalAlpha ? EXACTBOUND : UPPERBOUND);
+    return best;
+}
+
+uint64_t countNodes(const Search *const restrict searches, const int count) {
+    uint64_t nodes = 0;
+    for (int i = 0; i < count; ++i) nodes += searches[i].nodes;
+    return nodes;
+}
+
+void printSearchInfo(const Search *const restrict search, const int depth, const int score, const uint64_t nodes) {
+    const double seconds = elapsedSeconds(&search->start);
+    char coordinates[6];
+    // Keeps the line in one piece while the UCI input loop answers on the same stream
+    flockfile(stdout);
+    printf("info depth %d score ", depth);
+    if (abs(score) >= MATE_SCORE - MAX_PLY) printf("mate %d", score > 0 ? (MATE_SCORE - score + 1) / 2 : -(MATE_SCORE + score) / 2);
+    else printf("cp %d", score);
+    printf(" nodes %llu nps %.0f time %.0f pv", (unsigned long long)nodes, nodes / (seconds > 0 ? seconds : 1e-9), seconds * 1000);
+    for (int i = 0; i < search->pvLength[0]; ++i) printf(" %s", formatCoordinates(search->pv[0][i], coordinates));
+    putchar('\n');
+    funlockfile(stdout);
+}
+
+// Iterative deepening, where every iteration starts with the line of the previous one. The main thread only starts an iteration that is likely
+// to finish in time and reports it; every other helper starts one ply deeper so they spread over more of the tree they share through the table
+void *iterativeDeepening(void *argument) {
+    Search *const search = argument;
+    const SearchLimits *const limits = &search->limits;
+    for (int depth = 1 + search->id % 2; depth < MAX_PLY && (!limits->depth || depth <= limits->depth); ++depth) {
+        search->followPV = true;
+        const int score = alphaBeta(&search->state, search, -INFINITE_SCORE, INFINITE_SCORE, depth, 0);
+        if (search->stopped) break;
+        search->bestMove = search->pv[0][0];
+        search->completedDepth = depth;
+        search->previousLength = search->pvLength[0];
+        memcpy(search->previousPV, search->pv[0], search->pvLength[0] * sizeof(Move));
+        if (search->id) continue;
+        if (search->verbose) printSearchInfo(search, depth, score, countNodes(search, search->threadCount));
+        if (abs(score) >= MATE_SCORE - MAX_PLY || (limits->nodes && search->nodes >= limits->nodes)) break;
+        if (limits->moveTime && elapsedSeconds(&search->start) * 2000 >= limits->moveTime) break;
+    }
+    return NULL;
+}
+
+// Searches on the main thread while the helpers run until it raises the stop flag, each on its own copy of the position
+Move findBestMove(const GameState *const restrict position, const SearchLimits *const restrict limits, const bool verbose) {
+    Search *const searches = threadSearches;
+    pthread_t threads[MAX_THREADS];
+    int started = 0;
+    ++transpositionTable.generation;
+    for (int i = 0; i < searchThreads; ++i) {
+        memset(&searches[i], 0, sizeof(Search));
+        searches[i].state = *position;
+        refreshEvaluation(&searches[i].state);
+        searches[i].id = i;
+        searches[i].limits = i ? (SearchLimits){ .depth = limits->depth } : *limits;
+        searches[i].verbose = verbose;
+        searches[i].threadCount = searchThreads;
+        clock_gettime(CLOCK_MONOTONIC, &searches[i].start);
+    }
+    for (int i = 1; i < searchThreads; ++i) if (!pthread_create(&threads[started], NULL, iterativeDeepening, &searches[i])) ++started;
+    iterativeDeepening(&searches[0]);
+    stopSearch = true;
+    for (int i = 0; i < started; ++i) pthread_join(threads[i], NULL);
+    return searches[0].bestMove;
+}
+
+// Usage: bench [depth], searches the test positions to a fixed depth with 1 to 32 threads and compares the time it takes
+int runBench(const int argc, char **const argv) {
+    const SearchLimits limits = { .depth = argc > 0 ? atoi(argv[0]) : 7 };
+    const int savedThreads = searchThreads;
+    double baseline = 0;
+    GameState state;
+    if (limits.depth < 1 || (!transpositionTable.clusters && !resizeTable(DEFAULT_HASH_SIZE))) return -1;
+    printf("Time to depth %d over %d positions\nthreads  seconds  speedup  cutoffs by the first move\n", limits.depth, PERFT_SUITE_SIZE);
+    for (searchThreads = 1; searchThreads <= 32 && searchThreads <= MAX_THREADS; searchThreads *= 2) {
+        double seconds = 0;
+        uint64_t cutoffs = 0, firstMoveCutoffs = 0;
+        for (int position = 0; position < PERFT_SUITE_SIZE; ++position) {
+            struct timespec start;
+            setPosition(perftSuite[position].fen, &state);
+            memset(transpositionTable.clusters, 0, (transpositionTable.mask + 1) * sizeof(Cluster));
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            stopSearch = false;
+            findBestMove(&state, &limits, false);
+            seconds += elapsedSeconds(&start);
+            for (int i = 0; i < searchThreads; ++i) {
+                cutoffs += threadSearches[i].cutoffs;
+                firstMoveCutoffs += threadSearches[i].firstMoveCutoffs;
+            }
+        }
+        if (searchThreads == 1) baseline = seconds;
+        printf("%7d  %7.3f  %7.2f  %24.1f%%\n", searchThreads, seconds, baseline / seconds, cutoffs ? 100.0 * firstMoveCutoffs / cutoffs : 0);
+    }
+    searchThreads = savedThreads;
+    return 0;
+}
+
+// Evaluates every position down to the depth, each right after makeMove updated the evaluation the way it does in the search
+uint64_t walkEvaluations(GameState *const restrict state, const int depth, const bool useNetwork, int64_t *const restrict sum) {
+    MoveList moves;
+    Undo undo;
+    uint64_t count = 1;
+    *sum += useNetwork ? evaluateNetwork(state) : evaluateClassical(state);
+    if (!depth) return count;
+    generateLegalMoves(state, &moves);
+    for (int i = 0; i < moves.count; ++i) {
+        makeMove(state, moves.moves[i], &undo);
+        count += walkEvaluations(state, depth - 1, useNetwork, sum);
+        unmakeMove(state, &undo);
+    }
+    return count;
+}
+
+// Usage: evalbench [--network <file>] [depth], measures both evaluations on every position down to the depth below the test positions.
+// Without a network file it measures one with random weights. The sums of the scores have to be the same whatever instruction set was used
+int runEvaluationBench(const int argc, char **const argv) {
+    int depth = EVALUATION_BENCH_DEPTH;
+    GameState state;
+    for (int i = 0; i < argc; ++i) {
+        if (strcmp(argv[i], "--network") == 0 && i + 1 < argc) {
+            if (loadNetwork(argv[++i])) continue;
+            printf("Could not read the network file %s.\n", argv[i]);
+            return -1;
+        }
+        depth = atoi(argv[i]);
+    }
+    if (depth < 0 || (!network && !randomizeNetwork())) return -1;
+    Network *const loaded = network;
+    printf("Evaluations down to depth %d below %d positions, network with %d lanes per instruction%s\nevaluator  evaluations  seconds  per second  sum of scores\n", depth, PERFT_SUITE_SIZE, SIMD_LANES, argc && strcmp(argv[0], "--network") == 0 ? "" : " and random weights");
+    for (int useNetwork = 0; useNetwork < 2; ++useNetwork) {
+        struct timespec start;
+        uint64_t count = 0;
+        int64_t sum = 0;
+        // The accumulators are only updated while a network is loaded
+        network = useNetwork ? loaded : NULL;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        for (int position = 0; position < PERFT_SUITE_SIZE; ++position) {
+            setPosition(perftSuite[position].fen, &state);
+            refreshEvaluation(&state);
+            count += walkEvaluations(&state, depth, useNetwork, &sum);
+        }
+        const double seconds = elapsedSeconds(&start);
+        printf("%-9s  %11llu  %7.3f  %10.0f  %13lld\n", useNetwork ? "network" : "classical", (unsigned long long)count, seconds, count / (seconds > 0 ? seconds : 1e-9), (long long)sum);
+    }
+    free(network);
+    network = NULL;
+    return 0;
+}
+
+// Finds the legal move written as origin and destination square followed by the promotion piece, e.g. e7e8q
+bool parseCoordinates(const GameState *const restrict state, const char *const restrict text, Move *const restrict move) {
+    MoveList moves;
+    char coordinates[6];
+    generateLegalMoves(state, &moves);
+    for (int i = 0; i < moves.count; ++i) {
+        if (strcmp(formatCoordinates(moves.moves[i], coordinates), text) != 0) continue;
+        *move = moves.moves[i];
         return true;
     }
     return false;
 }
 
-bool initializeGameLog(GameLog *restrict game) {
-    game->chunkCount = 0;
-    Chunk *ptr = malloc(sizeof(Chunk));
-    if (!ptr) {
-        puts("\n[ERROR] Unable to start the game.");
+// Without a legal move the search finds nothing, which UCI writes as 0000
+void *uciSearch(void *argument) {
+    SearchJob *const job = argument;
+    char coordinates[6];
+    Move best;
+    if (probeBook(&job->position, &best)) puts("info string book move");
+    else best = findBestMove(&job->position, &job->limits, true);
+    pthread_mutex_lock(&job->lock);
+    while (job->isHeld) pthread_cond_wait(&job->changed, &job->lock);
+    pthread_mutex_unlock(&job->lock);
+    printf("bestmove %s\n", best ? formatCoordinates(best, coordinates) : "0000");
+    return NULL;
+}
+
+// Lets a search started by "go infinite" or "go ponder" send its answer once it has one
+void releaseSearch(SearchJob *const restrict job) {
+    pthread_mutex_lock(&job->lock);
+    job->isHeld = false;
+    pthread_cond_broadcast(&job->changed);
+    pthread_mutex_unlock(&job->lock);
+}
+
+// Waits for a running search to finish, stopping it first if asked to or if it would only end on "stop" or "ponderhit"
+void waitForSearch(SearchJob *const restrict job, const bool stop) {
+    if (!job->isRunning) return;
+    if (stop || job->isHeld) stopSearch = true;
+    releaseSearch(job);
+    pthread_join(job->thread, NULL);
+    job->isRunning = false;
+}
+
+// Speaks UCI over stdin and stdout. Searches run on their own thread, so the input loop keeps answering "isready" and "stop" meanwhile
+int runUci(void) {
+    static char line[UCI_BUFFER_SIZE];
+    static SearchJob job;
+    const char *const delimiters = " \t\r\n";
+    setvbuf(stdout, NULL, _IOLBF, 0);
+    setPosition(START_POSITION, &job.position);
+    pthread_mutex_init(&job.lock, NULL);
+    pthread_cond_init(&job.changed, NULL);
+    while (fgets(line, UCI_BUFFER_SIZE, stdin)) {
+        char *token = strtok(line, delimiters);
+        if (!token) continue;
+        if (strcmp(token, "uci") == 0) {
+            printf("id name Terminal Chess\nid author The Terminal Chess developers\n");
+            printf("option name Hash type spin default %d min 1 max %d\n", DEFAULT_HASH_SIZE, MAX_HASH_SIZE);
+            printf("option name Threads type spin default 1 min 1 max %d\n", MAX_THREADS);
+            puts("option name Book type string default <empty>\noption name BookKeys type string default <empty>\noption name EvalFile type string default <empty>\nuciok");
+        } else if (strcmp(token, "isready") == 0) {
+            puts("readyok");
+        } else if (strcmp(token, "stop") == 0) {
+            waitForSearch(&job, true);
+        } else if (strcmp(token, "ponderhit") == 0) {
+            if (job.isRunning) releaseSearch(&job);
+        } else if (strcmp(token, "quit") == 0) {
+            break;
+        } else if (strcmp(token, "ucinewgame") == 0) {
+            waitForSearch(&job, true);
+            memset(transpositionTable.clusters, 0, (transpositionTable.mask + 1) * sizeof(Cluster));
+        } else if (strcmp(token, "setoption") == 0) {
+            // setoption name <name> value <value>
+            strtok(NULL, delimiters);
+            const char *const name = strtok(NULL, delimiters), *value = strtok(NULL, delimiters);
+            value = strtok(NULL, delimiters);
+            if (!name || !value) continue;
+            waitForSearch(&job, false);
+            if (strcmp(name, "Hash") == 0 && (atol(value) < 1 || atol(value) > MAX_HASH_SIZE)) printf("info string The hash table size has to be between 1 and %d MB.\n", MAX_HASH_SIZE);
+            else if (strcmp(name, "Hash") == 0 && !resizeTable(atol(value))) puts("info string Could not allocate a hash table of that size.");
+            if (strcmp(name, "Threads") == 0 && atoi(value) >= 1 && atoi(value) <= MAX_THREADS) searchThreads = atoi(value);
+            if (strcmp(name, "Book") == 0 && strcmp(value, "<empty>") != 0 && !openBook(value)) puts("info string Could not open the opening book.");
+            if (strcmp(name, "BookKeys") == 0 && strcmp(value, "<empty>") != 0 && !loadPolyglotKeys(value)) puts("info string Could not read the 781 Polyglot keys from the key file.");
+            if (strcmp(name, "EvalFile") == 0 && strcmp(value, "<empty>") != 0 && !loadNetwork(value)) puts("info string Could not read the network file.");
+        } else if (strcmp(token, "position") == 0) {
+            char fenStr[BUFFER_SIZE] = START_POSITION;
+            Move move;
+            Undo undo;
+            waitForSearch(&job, false);
+            token = strtok(NULL, delimiters);
+            if (token && strcmp(token, "fen") == 0) {
+                fenStr[0] = '\0';
+                for (int field = 0; field < 6 && (token = strtok(NULL, delimiters)) && strcmp(token, "moves") != 0; ++field) {
+                    if (field) strncat(fenStr, " ", BUFFER_SIZE - strlen(fenStr) - 1);
+                    strncat(fenStr, token, BUFFER_SIZE - strlen(fenStr) - 1);
+                }
+            }
+            if (!setPosition(fenStr, &job.position)) {
+                puts("info string That was not a valid FEN notation.");
+                setPosition(START_POSITION, &job.position);
+                continue;
+            }
+            while ((token = strtok(NULL, delimiters))) {
+                if (strcmp(token, "moves") == 0) continue;
+                if (!parseCoordinates(&job.position, token, &move)) {
+                    printf("info string Illegal move %s\n", token);
+                    break;
+                }
+                makeMove(&job.position, move, &undo);
+            }
+        } else if (strcmp(token, "go") == 0) {
+            const bool isWhite = job.position.status == WHITE;
+            long timeLeft = 0, increment = 0, movesToGo = 0;
+            waitForSearch(&job, false);
+            job.limits = (SearchLimits){0};
+            job.isHeld = false;
+            while ((token = strtok(NULL, delimiters))) {
+                if (strcmp(token, "infinite") == 0 || strcmp(token, "ponder") == 0) {
+                    job.isHeld = true;
+                    continue;
+                }
+                const char *const value = strtok(NULL, delimiters);
+                if (!value) break;
+                if (strcmp(token, "depth") == 0) job.limits.depth = atoi(value);
+                else if (strcmp(token, "nodes") == 0) job.limits.nodes = strtoull(value, NULL, 10);
+                else if (strcmp(token, "movetime") == 0) job.limits.moveTime = atol(value);
+                else if (strcmp(token, isWhite ? "wtime" : "btime") == 0) timeLeft = atol(value);
+                else if (strcmp(token, isWhite ? "winc" : "binc") == 0) increment = atol(value);
+                else if (strcmp(token, "movestogo") == 0) movesToGo = atol(value);
+            }
+            // Spends an even share of the clock on every move left until the next time control, assuming 30 if there is none
+            if (timeLeft && !job.limits.moveTime) {
+                job.limits.moveTime = timeLeft / (movesToGo ? movesToGo : 30) + increment / 2;
+                if (job.limits.moveTime > timeLeft - 50) job.limits.moveTime = timeLeft > 100 ? timeLeft - 50 : timeLeft / 2 + 1;
+            }
+            stopSearch = false;
+            job.isRunning = !pthread_create(&job.thread, NULL, uciSearch, &job);
+        }
+    }
+    waitForSearch(&job, true);
+    pthread_cond_destroy(&job.changed);
+    pthread_mutex_destroy(&job.lock);
+    return 0;
+}
+
+// Writes the move as origin and destination square followed by the promotion piece, e.g. e7e8q
+char *formatCoordinates(const Move move, char *const restrict buffer) {
+    int i = 0;
+    buffer[i++] = moveOrigin(move) % BOARD_SIZE + 'a';
+    buffer[i++] = '8' - moveOrigin(move) / BOARD_SIZE;
+    buffer[i++] = moveDestination(move) % BOARD_SIZE + 'a';
+    buffer[i++] = '8' - moveDestination(move) / BOARD_SIZE;
+    if (isPromotion(move)) buffer[i++] = PIECE_SYMBOLS[6 + promotionSet(move)];
+    buffer[i] = '\0';
+    return buffer;
+}
+
+// Loads a FEN string for the headless modes, where a position that is already mate still counts as the mated side to move
+bool setPosition(const char *const restrict fenStr, GameState *const restrict state) {
+    *state = (GameState){ .move = 0 };
+    if (!parseFEN(fenStr, strlen(fenStr), state)) return false;
+    if (state->status == WIN || state->status == LOSE) state->status = state->status == LOSE ? WHITE : BLACK;
+    state->key = state->keyHistory[0] = computeKey(state);
+    return true;
+}
+
+uint64_t perft(GameState *const restrict state, const int depth, PerftTable *const restrict table) {
+    MoveList moves;
+    Undo undo;
+    uint64_t nodes = 0;
+    if (depth == 0) return 1;
+    PerftEntry *const entry = table->entries && depth > 1 ? &table->entries[state->key & table->mask] : NULL;
+    if (entry) {
+        const PerftEntry found = *entry;
+        if ((found.check ^ found.data) == state->key && (int)(found.data & 0xFF) == depth) return found.data >> 8;
+    }
+    generateLegalMoves(state, &moves);
+    if (depth == 1) return moves.count;
+    for (int i = 0; i < moves.count; ++i) {
+        makeMove(state, moves.moves[i], &undo);
+        nodes += perft(state, depth - 1, table);
+        unmakeMove(state, &undo);
+    }
+    if (entry) *entry = (PerftEntry){ state->key ^ (nodes << 8 | depth), nodes << 8 | depth };
+    return nodes;
+}
+
+// Takes root moves off the shared list until none are left, so the threads stay busy even if the subtrees differ a lot in size
+void *perftWorker(void *argument) {
+    PerftJob *const job = argument;
+    GameState state = job->root;
+    Undo undo;
+    while (true) {
+        pthread_mutex_lock(&job->lock);
+        const int i = job->nextMove++;
+        pthread_mutex_unlock(&job->lock);
+        if (i >= job->moves.count) return NULL;
+        makeMove(&state, job->moves.moves[i], &undo);
+        job->counts[i] = perft(&state, job->depth - 1, &job->table);
+        unmakeMove(&state, &undo);
+    }
+}
+
+// Counts the leaf nodes below every root move on the given number of threads, returns the total
+uint64_t divide(PerftJob *const restrict job, const int threadCount, const bool verbose) {
+    pthread_t threads[MAX_THREADS];
+    char coordinates[6];
+    uint64_t nodes = 0;
+    generateLegalMoves(&job->root, &job->moves);
+    job->nextMove = 0;
+    if (job->depth == 0) return 1;
+    int started = 0;
+    pthread_mutex_init(&job->lock, NULL);
+    // The workers share the root moves, so any that could not be started are simply not missed
+    for (int i = 0; i < threadCount; ++i) if (!pthread_create(&threads[started], NULL, perftWorker, job)) ++started;
+    if (!started) perftWorker(job);
+    for (int i = 0; i < started; ++i) pthread_join(threads[i], NULL);
+    pthread_mutex_destroy(&job->lock);
+    for (int i = 0; i < job->moves.count; ++i) {
+        if (verbose) printf("%s: %llu\n", formatCoordinates(job->moves.moves[i], coordinates), (unsigned long long)job->counts[i]);
+        nodes += job->counts[i];
+    }
+    return nodes;
+}
+
+double elapsedSeconds(const struct timespec *const restrict start) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+// Usage: perft [--threads <n>] [--hash <MB>] <depth> [fen], or perft [--threads <n>] [--hash <MB>] suite [depth] to check the standard positions
+int runPerft(const int argc, char **const argv) {
+    static PerftJob job;
+    char fenStr[BUFFER_SIZE] = START_POSITION;
+    long threadCount = sysconf(_SC_NPROCESSORS_ONLN), hashSize = 0;
+    int i = 0, depth = 0, failures = 0;
+    for (; i + 1 < argc && strncmp(argv[i], "--", 2) == 0; i += 2) {
+        if (strcmp(argv[i], "--threads") == 0) threadCount = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--hash") == 0) hashSize = atol(argv[i + 1]);
+        else break;
+    }
+    if (threadCount < 1) threadCount = 1;
+    if (threadCount > MAX_THREADS) threadCount = MAX_THREADS;
+    if (hashSize > MAX_HASH_SIZE) hashSize = MAX_HASH_SIZE;
+    if (hashSize > 0) {
+        size_t entryCount = 1;
+        while (entryCount * 2 * sizeof(PerftEntry) <= (size_t)hashSize << 20) entryCount *= 2;
+        job.table = (PerftTable){ calloc(entryCount, sizeof(PerftEntry)), entryCount - 1 };
+        if (!job.table.entries) {
+            puts("[ERROR] Unable to allocate the hash table.");
+            return -1;
+        }
+    }
+    if (i < argc && strcmp(argv[i], "suite") == 0) {
+        if ((depth = i + 1 < argc ? atoi(argv[i + 1]) : 4) < 1) {
+            puts("Usage: perft [--threads <n>] [--hash <MB>] <depth> [fen] | suite [depth]");
+            free(job.table.entries);
+            return -1;
+        }
+        for (int position = 0; position < PERFT_SUITE_SIZE; ++position) {
+            const PerftPosition *const test = &perftSuite[position];
+            struct timespec start;
+            job.depth = depth < PERFT_SUITE_DEPTH ? depth : PERFT_SUITE_DEPTH;
+            setPosition(test->fen, &job.root);
+            clock_gettime(CLOCK_MONOTONIC, &start);
+            const uint64_t nodes = divide(&job, threadCount, false);
+            const double seconds = elapsedSeconds(&start);
+            const bool passed = nodes == test->counts[job.depth - 1];
+            failures += !passed;
+            printf("%-4s depth %d: %llu nodes, %.0f nps  %s\n", passed ? "ok" : "FAIL", job.depth, (unsigned long long)nodes, nodes / (seconds > 0 ? seconds : 1e-9), test->fen);
+        }
+        for (int position = 0; position < ILLEGAL_SUITE_SIZE; ++position) {
+            const bool passed = !setPosition(illegalSuite[position], &job.root);
+            failures += !passed;
+            printf("%-4s rejected as illegal  %s\n", passed ? "ok" : "FAIL", illegalSuite[position]);
+        }
+    } else {
+        if (i >= argc || (depth = atoi(argv[i])) < 0) {
+            puts("Usage: perft [--threads <n>] [--hash <MB>] <depth> [fen] | suite [depth]");
+            free(job.table.entries);
+            return -1;
+        }
+        // A FEN string passed without quotes arrives split into its fields
+        if (++i < argc) {
+            fenStr[0] = '\0';
+            for (; i < argc; ++i) {
+                strncat(fenStr, argv[i], BUFFER_SIZE - strlen(fenStr) - 1);
+                if (i + 1 < argc) strncat(fenStr, " ", BUFFER_SIZE - strlen(fenStr) - 1);
+            }
+        }
+        if (!setPosition(fenStr, &job.root)) {
+            puts("That was not a valid FEN notation.");
+            free(job.table.entries);
+            return -1;
+        }
+        struct timespec start;
+        job.depth = depth;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        const uint64_t nodes = divide(&job, threadCount, true);
+        const double seconds = elapsedSeconds(&start);
+        printf("\nNodes: %llu\nTime: %.3f s\nNPS: %.0f\n", (unsigned long long)nodes, seconds, nodes / (seconds > 0 ? seconds : 1e-9));
+    }
+    free(job.table.entries);
+    return failures ? -1 : 0;
+}
+
+bool appendText(TextBuffer *const restrict buffer, const char *const restrict text, const size_t length) {
+    if (buffer->length + length + 1 > buffer->capacity) {
+        size_t capacity = buffer->capacity ? buffer->capacity : 4096;
+        while (buffer->length + length + 1 > capacity) capacity *= 2;
+        char *const grown = realloc(buffer->text, capacity);
+        if (!grown) return false;
+        buffer->text = grown;
+        buffer->capacity = capacity;
+    }
+    if (length) memcpy(&buffer->text[buffer->length], text, length);
+    buffer->length += length;
+    buffer->text[buffer->length] = '\0';
+    return true;
+}
+
+bool appendFormatted(TextBuffer *const restrict buffer, const char *const restrict format, ...) {
+    char line[2 * BUFFER_SIZE];
+    va_list args;
+    va_start(args, format);
+    const int length = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (length < 0) return false;
+    if ((size_t)length < sizeof(line)) return appendText(buffer, line, length);
+    // Longer lines, e.g. behind a long file name, are formatted again into a line of their own length
+    char *const longLine = malloc(length + 1);
+    if (!longLine) return false;
+    va_start(args, format);
+    vsnprintf(longLine, length + 1, format, args);
+    va_end(args);
+    const bool isAppended = appendText(buffer, longLine, length);
+    free(longLine);
+    return isAppended;
+}
+
+// Archives store every number in little endian byte order, so they can be read on any machine
+void putBytes(char *const restrict to, const uint64_t value, const int size) {
+    for (int i = 0; i < size; ++i) to[i] = (char)(value >> 8 * i);
+}
+
+uint64_t readBytes(const void *const restrict from, const int size) {
+    uint64_t value = 0;
+    for (int i = 0; i < size; ++i) value |= (uint64_t)((const unsigned char *)from)[i] << 8 * i;
+    return value;
+}
+
+bool appendBytes(TextBuffer *const restrict buffer, const uint64_t value, const int size) {
+    char bytes[8];
+    putBytes(bytes, value, size);
+    return appendText(buffer, bytes, size);
+}
+
+// Stores the [%clk h:mm:ss] and [%eval] commands of a comment as the clock time in centiseconds and the evaluation in centipawns of the move before it
+void readAnnotations(const char *comment, const char *const restrict end, PgnBatch *const restrict batch) {
+    for (; comment < end; ++comment) {
+        int hours, minutes, mate;
+        double seconds, pawns;
+        if (*comment != '[') continue;
+        if (strncmp(comment, "[%clk ", 6) == 0 && sscanf(comment + 6, "%d:%d:%lf", &hours, &minutes, &seconds) == 3 && hours >= 0 && hours < 10000) {
+            putBytes(&batch->clocks.text[batch->clocks.length - 4], (uint32_t)((hours * 3600 + minutes * 60 + seconds) * 100 + 0.5), 4);
+        } else if (strncmp(comment, "[%eval ", 7) == 0) {
+            // Mates are stored like the scores of the search, a mate in n moves counting n away from MATE_SCORE
+            if (sscanf(comment + 7, "#%d", &mate) == 1 && abs(mate) < 1000) putBytes(&batch->evals.text[batch->evals.length - 2], (uint16_t)(mate > 0 ? MATE_SCORE - mate : -MATE_SCORE - mate), 2);
+            else if (sscanf(comment + 7, "%lf", &pawns) == 1) putBytes(&batch->evals.text[batch->evals.length - 2], (uint16_t)(int)(pawns > 299 ? 29900 : pawns < -299 ? -29900 : pawns * 100 + (pawns < 0 ? -0.5 : 0.5)), 2);
+        }
+    }
+}
+
+// Appends the replayed game to the records of the batch. A record starts with a byte of flags (1: FEN, 2: clock times, 4: evaluations),
+// the index of the result, the number of plies and the length of the tags, followed by the FEN string after its length, the tags,
+// the moves and the clock times and evaluations of every ply if their flags are set
+bool packGame(PgnBatch *const restrict batch, const char *const restrict fenStr, const char *const restrict result, const int plyCount) {
+    const size_t fenLength = strcmp(fenStr, START_POSITION) != 0 ? strlen(fenStr) : 0;
+    bool hasClocks = false, hasEvals = false;
+    int resultIndex = 0;
+    for (int i = 0; i < plyCount; ++i) {
+        hasClocks |= readBytes(&batch->clocks.text[4 * i], 4) != NO_CLOCK;
+        hasEvals |= (int16_t)readBytes(&batch->evals.text[2 * i], 2) != NO_EVAL;
+    }
+    while (resultIndex < 3 && strcmp(results[resultIndex], result) != 0) ++resultIndex;
+    batch->recordOffsets[batch->recordCount++] = batch->records.length;
+    return appendBytes(&batch->records, (fenLength != 0) | hasClocks << 1 | hasEvals << 2, 1) && appendBytes(&batch->records, resultIndex, 1)
+        && appendBytes(&batch->records, plyCount, 2) && appendBytes(&batch->records, batch->tags.length, 2)
+        && (!fenLength || (appendBytes(&batch->records, fenLength, 1) && appendText(&batch->records, fenStr, fenLength)))
+        && appendText(&batch->records, batch->tags.text, batch->tags.length) && appendText(&batch->records, batch->moves.text, batch->moves.length)
+        && (!hasClocks || appendText(&batch->records, batch->clocks.text, batch->clocks.length))
+        && (!hasEvals || appendText(&batch->records, batch->evals.text, batch->evals.length));
+}
+
+// Plays the moves of one game from its FEN tag or the start position and appends "<file>:<game> <result> <final FEN>", followed by the first illegal move if there is one
+bool replayGame(const char *game, const unsigned long number, PgnBatch *const restrict batch) {
+    GameState state;
+    LegalMoves legal = {0};
+    Move move;
+    Undo undo;
+    char fenStr[BUFFER_SIZE] = START_POSITION, result[8] = "*", name[16], value[BUFFER_SIZE], token[BUFFER_SIZE];
+    const char *illegalMove = NULL;
+    bool isStored = true;
+    int ply = 0;
+    batch->tags.length = batch->moves.length = batch->clocks.length = batch->evals.length = 0;
+    while (true) {
+        while (isspace(*game)) ++game;
+        if (*game != '[') break;
+        if (sscanf(game, "[%15s \"%99[^\"]\"", name, value) == 2) {
+            const size_t length = strlen(name) + strlen(value) + 2;
+            if (strcmp(name, "FEN") == 0) strcpy(fenStr, value);
+            else if (strcmp(name, "Result") == 0) snprintf(result, sizeof(result), "%.7s", value);
+            else if (batch->isPacking && strcmp(name, "SetUp") != 0 && batch->tags.length + length <= UINT16_MAX) {
+                isStored &= appendText(&batch->tags, name, strlen(name) + 1) && appendText(&batch->tags, value, strlen(value) + 1);
+            }
+        }
+        game += strcspn(game, "\n");
+    }
+    if (!setPosition(fenStr, &state)) {
+        ++batch->illegalCount;
+        return isStored && appendFormatted(&batch->output, "%s:%lu %s invalid FEN tag \"%s\"\n", batch->fileName, number, result, fenStr);
+    }
+    while (*game && !illegalMove) {
+        if (isspace(*game) || *game == ')') {
+            ++game;
+        } else if (*game == '{') {
+            const char *const end = game + strcspn(game, "}");
+            if (batch->isPacking && ply) readAnnotations(game, end, batch);
+            game = *end ? end + 1 : end;
+        } else if (*game == ';' || *game == '%') {
+            game += strcspn(game, "\n");
+        } else if (*game == '(') {
+            // Variations may nest and contain comments with parentheses of their own
+            for (int depth = 0; *game; ++game) {
+                if (*game == '{') game += strcspn(game, "}");
+                if (!*game) break;
+                depth += (*game == '(') - (*game == ')');
+                if (depth == 0) break;
+            }
+            if (*game) ++game;
+        } else {
+            const size_t length = strcspn(game, " \t\r\n{}();");
+            snprintf(token, sizeof(token), "%.*s", (int)(length < sizeof(token) ? length : sizeof(token) - 1), game);
+            game += length;
+            if (token[0] == '$') continue;
+            if (strcmp(token, "1-0") == 0 || strcmp(token, "0-1") == 0 || strcmp(token, "1/2-1/2") == 0 || strcmp(token, "*") == 0) {
+                strcpy(result, token);
+                break;
+            }
+            // Move numbers may stick to the move that follows them, as in "12.Nf3" or "12...Nf6"
+            const char *san = token;
+            while (isdigit(*san)) ++san;
+            if (*san == '.') while (*san == '.') ++san;
+            else if (*san) san = token;
+            if (!*san) continue;
+            if (!validateMove(san, &state, &legal, &move) || (batch->isPacking && ply == UINT16_MAX)) {
+                illegalMove = token;
+                break;
+            }
+            makeMove(&state, move, &undo);
+            ++ply;
+            if (batch->isPacking) isStored &= appendBytes(&batch->moves, move, 2) && appendBytes(&batch->clocks, NO_CLOCK, 4) && appendBytes(&batch->evals, (uint16_t)NO_EVAL, 2);
+        }
+    }
+    // Packing only reports the games it has to leave out
+    if (!illegalMove && batch->isPacking) return isStored && packGame(batch, fenStr, result, ply);
+    writeFEN(&state, value);
+    if (!illegalMove) return appendFormatted(&batch->output, "%s:%lu %s %s\n", batch->fileName, number, result, value);
+    ++batch->illegalCount;
+    return isStored && appendFormatted(&batch->output, "%s:%lu %s %s illegal move \"%s\" at ply %d\n", batch->fileName, number, result, value, illegalMove, ply + 1);
+}
+
+void *pgnWorker(void *argument) {
+    PgnQueue *const queue = argument;
+    pthread_mutex_lock(&queue->lock);
+    while (true) {
+        while (queue->taken == queue->filled && !queue->isFinished) pthread_cond_wait(&queue->changed, &queue->lock);
+        if (queue->taken == queue->filled) break;
+        PgnBatch *const batch = &queue->batches[queue->taken++ % queue->slotCount];
+        pthread_mutex_unlock(&queue->lock);
+        for (int i = 0; i < batch->gameCount && !batch->failed; ++i) batch->failed = !replayGame(&batch->games.text[batch->offsets[i]], batch->firstGame + i, batch);
+        pthread_mutex_lock(&queue->lock);
+        batch->isDone = true;
+        pthread_cond_broadcast(&queue->changed);
+    }
+    pthread_mutex_unlock(&queue->lock);
+    return NULL;
+}
+
+// Prints the replayed batches in input order, waiting for the oldest one while every slot is in use, or until all are printed if drain is set
+void printBatches(PgnQueue *const restrict queue, const bool drain) {
+    pthread_mutex_lock(&queue->lock);
+    while (queue->printed < queue->filled) {
+        PgnBatch *const batch = &queue->batches[queue->printed % queue->slotCount];
+        if (!batch->isDone) {
+            if (!drain && queue->filled - queue->printed < (unsigned long)queue->slotCount) break;
+            pthread_cond_wait(&queue->changed, &queue->lock);
+            continue;
+        }
+        pthread_mutex_unlock(&queue->lock);
+        fwrite(batch->output.text, 1, batch->output.length, stdout);
+        if (batch->failed) printf("[ERROR] Ran out of memory while replaying the games of %s from game %lu on.\n", batch->fileName, batch->firstGame);
+        if (queue->archive && !queue->failed) {
+            for (int i = 0; i < batch->recordCount && !batch->failed; ++i) batch->failed = !appendBytes(&queue->index, queue->archiveSize + batch->recordOffsets[i], 8);
+            if (!batch->failed && fwrite(batch->records.text, 1, batch->records.length, queue->archive) != batch->records.length) {
+                puts("[ERROR] Unable to write the archive.");
+                batch->failed = true;
+            }
+            queue->archiveSize += batch->records.length;
+        }
+        pthread_mutex_lock(&queue->lock);
+        queue->gameCount += batch->gameCount;
+        queue->illegalCount += batch->illegalCount;
+        queue->failed |= batch->failed;
+        ++queue->printed;
+    }
+    pthread_mutex_unlock(&queue->lock);
+}
+
+// Empties the slot the next batch is read into, once the batch that used it before has been printed
+PgnBatch *nextBatch(PgnQueue *const restrict queue, const char *const restrict fileName, const unsigned long firstGame) {
+    printBatches(queue, false);
+    PgnBatch *const batch = &queue->batches[queue->filled % queue->slotCount];
+    batch->fileName = fileName;
+    batch->firstGame = firstGame;
+    batch->gameCount = batch->illegalCount = batch->recordCount = 0;
+    batch->games.length = batch->output.length = batch->records.length = 0;
+    batch->failed = batch->isDone = false;
+    batch->isPacking = queue->archive != NULL;
+    return batch;
+}
+
+void submitBatch(PgnQueue *const restrict queue) {
+    pthread_mutex_lock(&queue->lock);
+    ++queue->filled;
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+}
+
+// Usage: pgn [--threads <n>] <file>... where "-" reads stdin. Files are read line by line and cut into batches at game boundaries,
+// so at most two batches per thread are held in memory however large the files are. Packing writes the games to an archive instead
+int runPgn(const int argc, char **const argv, const bool isPacking) {
+    static PgnQueue queue;
+    pthread_t threads[MAX_THREADS];
+    long threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+    int i = 0, exitValue = 0, started = 0;
+    char *line = NULL;
+    size_t lineCapacity = 0;
+    struct timespec start;
+    for (; i + 1 < argc && strcmp(argv[i], "--threads") == 0; i += 2) threadCount = atol(argv[i + 1]);
+    if (i + isPacking >= argc) {
+        puts(isPacking ? "Usage: pack [--threads <n>] <archive> <file>..." : "Usage: pgn [--threads <n>] <file>...");
+        return -1;
+    }
+    if (threadCount < 1) threadCount = 1;
+    if (threadCount > MAX_THREADS) threadCount = MAX_THREADS;
+    if (isPacking) {
+        const char *const archiveName = argv[i++];
+        if (!(queue.archive = fopen(archiveName, "wb"))) {
+            printf("[ERROR] Unable to create %s.\n", archiveName);
+            return -1;
+        }
+        queue.archiveSize = fwrite(ARCHIVE_MAGIC, 1, 8, queue.archive);
+    }
+    queue.slotCount = 2 * threadCount;
+    pthread_mutex_init(&queue.lock, NULL);
+    pthread_cond_init(&queue.changed, NULL);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int j = 0; j < threadCount; ++j) if (!pthread_create(&threads[started], NULL, pgnWorker, &queue)) ++started;
+    if (!started) {
+        puts("[ERROR] Unable to start a thread replaying the games.");
+        queue.failed = true;
+    }
+    for (; i < argc && !queue.failed; ++i) {
+        FILE *const file = strcmp(argv[i], "-") == 0 ? stdin : fopen(argv[i], "r");
+        unsigned long gameNumber = 1;
+        bool hasMoves = false, hasText = false, isTerminated = false;
+        ssize_t length;
+        if (!file) {
+            printf("[ERROR] Unable to open %s.\n", argv[i]);
+            exitValue = -1;
+            continue;
+        }
+        PgnBatch *batch = nextBatch(&queue, argv[i], gameNumber);
+        size_t gameStart = 0;
+        while ((length = getline(&line, &lineCapacity, file)) != -1) {
+            if (!line[strspn(line, " \t\r\n")]) continue;
+            // A tag after the moves of a game or anything after its result starts the next one
+            if ((line[0] == '[' && hasMoves) || isTerminated) {
+                batch->offsets[batch->gameCount++] = gameStart;
+                ++gameNumber;
+                hasMoves = hasText = isTerminated = false;
+                if (batch->gameCount == PGN_BATCH_GAMES || batch->games.length >= PGN_BATCH_SIZE) {
+                    submitBatch(&queue);
+                    batch = nextBatch(&queue, argv[i], gameNumber);
+                }
+                gameStart = batch->games.length;
+            }
+            if (queue.failed || !appendText(&batch->games, line, length)) {
+                puts("[ERROR] Ran out of memory while reading the games.");
+                queue.failed = true;
+                break;
+            }
+            hasText = true;
+            if (line[0] == '[' || line[0] == '%') continue;
+            hasMoves = true;
+            while (length > 0 && isspace(line[length - 1])) line[--length] = '\0';
+            const char *const last = strrchr(line, ' ') ? strrchr(line, ' ') + 1 : line;
+            isTerminated = strcmp(last, "1-0") == 0 || strcmp(last, "0-1") == 0 || strcmp(last, "1/2-1/2") == 0 || strcmp(last, "*") == 0;
+        }
+        if (hasText) batch->offsets[batch->gameCount++] = gameStart;
+        if (batch->gameCount) submitBatch(&queue);
+        if (file != stdin) fclose(file);
+    }
+    pthread_mutex_lock(&queue.lock);
+    queue.isFinished = true;
+    pthread_cond_broadcast(&queue.changed);
+    pthread_mutex_unlock(&queue.lock);
+    printBatches(&queue, true);
+    for (int j = 0; j < started; ++j) pthread_join(threads[j], NULL);
+    const double seconds = elapsedSeconds(&start);
+    fprintf(stderr, "%lu games, %lu with illegal moves, %.0f games per second\n", queue.gameCount, queue.illegalCount, queue.gameCount / (seconds > 0 ? seconds : 1e-9));
+    if (queue.archive) {
+        const uint64_t gameCount = queue.index.length / 8;
+        if (!appendBytes(&queue.index, gameCount, 8) || !appendText(&queue.index, INDEX_MAGIC, 8) || fwrite(queue.index.text, 1, queue.index.length, queue.archive) != queue.index.length) queue.failed = true;
+        if (fclose(queue.archive) || queue.failed) {
+            puts("[ERROR] Unable to write the archive.");
+            queue.failed = true;
+        } else fprintf(stderr, "%llu games packed into %llu bytes\n", (unsigned long long)gameCount, (unsigned long long)(queue.archiveSize + queue.index.length));
+        free(queue.index.text);
+    }
+    for (int j = 0; j < queue.slotCount; ++j) {
+        PgnBatch *const batch = &queue.batches[j];
+        free(batch->games.text);
+        free(batch->output.text);
+        free(batch->records.text);
+        free(batch->tags.text);
+        free(batch->moves.text);
+        free(batch->clocks.text);
+        free(batch->evals.text);
+    }
+    free(line);
+    pthread_cond_destroy(&queue.changed);
+    pthread_mutex_destroy(&queue.lock);
+    return exitValue || queue.failed || queue.illegalCount ? -1 : 0;
+}
+
+const char *nextLine(const char *const restrict from, const char *const restrict end) {
+    const char *const newline = memchr(from, '\n', end - from);
+    return newline ? newline + 1 : end;
+}
+
+// Writes every line of the slice again as a normalized FEN string followed by its EPD operations, or after "invalid: " if it does not parse; blank lines stay blank
+void *fenWorker(void *argument) {
+    FenSlice *const slice = argument;
+    GameState state;
+    char fenStr[BUFFER_SIZE];
+    for (const char *line = slice->begin; line < slice->end && !slice->failed;) {
+        const char *const next = nextLine(line, slice->end);
+        size_t length = next - line, operations = 0;
+        while (length > 0 && isspace(line[length - 1])) --length;
+        state = (GameState){ .move = 0 };
+        if (!length) {
+            slice->failed = !appendText(&slice->output, "\n", 1);
+        } else if (!parseFEN(line, length, &state)) {
+            ++slice->invalidCount;
+            slice->failed = !appendText(&slice->output, "invalid: ", 9) || !appendText(&slice->output, line, length) || !appendText(&slice->output, "\n", 1);
+        } else {
+            ++slice->positionCount;
+            // The operations start after the en peasant square, or after the move counters if there are any
+            for (int field = 0; field < 6 && operations < length && (field != 4 || isdigit(line[operations])); ++field) {
+                while (operations < length && !isspace(line[operations])) ++operations;
+                while (operations < length && isspace(line[operations])) ++operations;
+            }
+            const int fenLength = writeFEN(&state, fenStr);
+            fenStr[fenLength] = operations < length ? ' ' : '\n';
+            slice->failed = !appendText(&slice->output, fenStr, fenLength + 1);
+            if (operations < length) slice->failed |= !appendText(&slice->output, &line[operations], length - operations) || !appendText(&slice->output, "\n", 1);
+        }
+        line = next;
+    }
+    return NULL;
+}
+
+// Usage: fen [--threads <n>] <file>. The file is mapped and read in windows, whose lines are split across the threads and written out again in order
+int runFen(const int argc, char **const argv) {
+    static FenSlice slices[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    bool isThreaded[MAX_THREADS];
+    long threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned long positionCount = 0, invalidCount = 0;
+    int i = 0, exitValue = 0;
+    struct stat info;
+    struct timespec start;
+    for (; i + 1 < argc && strcmp(argv[i], "--threads") == 0; i += 2) threadCount = atol(argv[i + 1]);
+    if (i >= argc) {
+        puts("Usage: fen [--threads <n>] <file>");
+        return -1;
+    }
+    if (threadCount < 1) threadCount = 1;
+    if (threadCount > MAX_THREADS) threadCount = MAX_THREADS;
+    const int file = open(argv[i], O_RDONLY);
+    if (file < 0 || fstat(file, &info) < 0) {
+        printf("[ERROR] Unable to open %s.\n", argv[i]);
+        if (file >= 0) close(file);
+        return -1;
+    }
+    const size_t size = info.st_size;
+    const char *const data = size ? mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0) : NULL;
+    if (data == MAP_FAILED) {
+        printf("[ERROR] Unable to map %s.\n", argv[i]);
+        close(file);
+        return -1;
+    }
+#ifdef MADV_SEQUENTIAL
+    if (size) madvise((void *)data, size, MADV_SEQUENTIAL);
+#endif
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (const char *window = data; window < data + size && !exitValue;) {
+        const char *const windowEnd = size - (window - data) > FEN_WINDOW_SIZE ? nextLine(window + FEN_WINDOW_SIZE - 1, data + size) : data + size;
+        const char *begin = window;
+        int sliceCount = 0;
+        for (; sliceCount < threadCount && begin < windowEnd; ++sliceCount) {
+            FenSlice *const slice = &slices[sliceCount];
+            const char *const end = begin + (windowEnd - begin) / (threadCount - sliceCount);
+            slice->begin = begin;
+            slice->end = nextLine(end > begin ? end - 1 : begin, windowEnd);
+            slice->output.length = slice->positionCount = slice->invalidCount = 0;
+            slice->failed = false;
+            // A slice without a thread of its own is worked through right away
+            if (!(isThreaded[sliceCount] = !pthread_create(&threads[sliceCount], NULL, fenWorker, slice))) fenWorker(slice);
+            begin = slice->end;
+        }
+        for (int j = 0; j < sliceCount; ++j) {
+            if (isThreaded[j]) pthread_join(threads[j], NULL);
+            if (slices[j].failed) {
+                puts("[ERROR] Ran out of memory while writing the positions.");
+                exitValue = -1;
+            }
+            fwrite(slices[j].output.text, 1, slices[j].output.length, stdout);
+            positionCount += slices[j].positionCount;
+            invalidCount += slices[j].invalidCount;
+        }
+        window = windowEnd;
+    }
+    const double seconds = elapsedSeconds(&start);
+    fprintf(stderr, "%lu positions, %lu invalid lines, %.0f positions per second\n", positionCount, invalidCount, positionCount / (seconds > 0 ? seconds : 1e-9));
+    for (int j = 0; j < threadCount; ++j) free(slices[j].output.text);
+    if (size) munmap((void *)data, size);
+    close(file);
+    return exitValue || invalidCount ? -1 : 0;
+}
+
+// Maps the archive and finds its index, which is checked to lie inside the file
+bool openArchive(const char *const restrict fileName, Archive *const restrict archive) {
+    struct stat info;
+    const int file = open(fileName, O_RDONLY);
+    *archive = (Archive){0};
+    if (file < 0 || fstat(file, &info) < 0 || info.st_size < 24) {
+        if (file >= 0) close(file);
         return false;
     }
-    game->log = ptr;
-    game->moveCounter = 0;
+    archive->size = info.st_size;
+    archive->data = mmap(NULL, archive->size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (archive->data == MAP_FAILED) return false;
+    archive->gameCount = readBytes(archive->data + archive->size - 16, 8);
+    if (memcmp(archive->data, ARCHIVE_MAGIC, 8) != 0 || memcmp(archive->data + archive->size - 8, INDEX_MAGIC, 8) != 0 || archive->gameCount > (archive->size - 24) / 8) {
+        munmap((void *)archive->data, archive->size);
+        return false;
+    }
+    archive->index = archive->data + archive->size - 16 - 8 * archive->gameCount;
+    return true;
+}
+
+// Finds the record of a game through the index, without reading any other game. Fails if the record does not fit between its offset and the next one
+bool readArchiveGame(const Archive *const restrict archive, const uint64_t number, ArchiveGame *const restrict game) {
+    const uint64_t offset = readBytes(archive->index + 8 * number, 8), end = number + 1 < archive->gameCount ? readBytes(archive->index + 8 * (number + 1), 8) : (uint64_t)(archive->index - archive->data);
+    if (offset < 8 || offset > end || end > (uint64_t)(archive->index - archive->data) || end - offset < 6) return false;
+    const unsigned char *const record = archive->data + offset;
+    const int flags = record[0];
+    if (record[1] > 3) return false;
+    game->result = results[record[1]];
+    game->plyCount = readBytes(record + 2, 2);
+    game->tagsLength = readBytes(record + 4, 2);
+    game->fenLength = flags & 1 ? record[6] : 0;
+    game->fen = flags & 1 ? (const char *)record + 7 : NULL;
+    game->tags = record + (flags & 1 ? 7 : 6) + game->fenLength;
+    game->moves = game->tags + game->tagsLength;
+    game->clocks = flags & 2 ? game->moves + 2 * game->plyCount : NULL;
+    game->evals = flags & 4 ? game->moves + (flags & 2 ? 6 : 2) * game->plyCount : NULL;
+    const unsigned char *const recordEnd = game->moves + (2 + (flags & 2 ? 4 : 0) + (flags & 4 ? 2 : 0)) * game->plyCount;
+    return game->fenLength < BUFFER_SIZE && (uint64_t)(recordEnd - archive->data) <= end && (!game->tagsLength || !game->tags[game->tagsLength - 1]);
+}
+
+// Plays the stored moves of the games straight from the legal move lists, and appends the same line per game as replayGame
+void *archiveWorker(void *argument) {
+    ArchiveSlice *const slice = argument;
+    ArchiveGame game;
+    GameState start, state;
+    MoveList moves;
+    Undo undo;
+    char fenStr[BUFFER_SIZE], coordinates[6];
+    setPosition(START_POSITION, &start);
+    for (uint64_t number = slice->first; number < slice->last && !slice->failed; ++number) {
+        const unsigned long long gameNumber = number + 1;
+        int ply = 0;
+        if (!readArchiveGame(slice->archive, number, &game)) {
+            ++slice->illegalCount;
+            slice->failed = !appendFormatted(&slice->output, "%s:%llu damaged record\n", slice->fileName, gameNumber);
+            continue;
+        }
+        snprintf(fenStr, sizeof(fenStr), "%.*s", game.fenLength, game.fen ? game.fen : "");
+        if (!game.fen) state = start;
+        else if (!setPosition(fenStr, &state)) {
+            ++slice->illegalCount;
+            slice->failed = !appendFormatted(&slice->output, "%s:%llu %s invalid FEN tag \"%s\"\n", slice->fileName, gameNumber, game.result, fenStr);
+            continue;
+        }
+        for (; ply < game.plyCount; ++ply) {
+            const Move move = readBytes(game.moves + 2 * ply, 2);
+            int i = 0;
+            generateLegalMoves(&state, &moves);
+            while (i < moves.count && moves.moves[i] != move) ++i;
+            if (i == moves.count) break;
+            makeMove(&state, move, &undo);
+        }
+        writeFEN(&state, fenStr);
+        if (ply == game.plyCount) {
+            slice->failed = !appendFormatted(&slice->output, "%s:%llu %s %s\n", slice->fileName, gameNumber, game.result, fenStr);
+            continue;
+        }
+        ++slice->illegalCount;
+        slice->failed = !appendFormatted(&slice->output, "%s:%llu %s %s illegal move \"%s\" at ply %d\n", slice->fileName, gameNumber, game.result, fenStr, formatCoordinates(readBytes(game.moves + 2 * ply, 2), coordinates), ply + 1);
+    }
+    return NULL;
+}
+
+// Usage: replay [--threads <n>] <archive>. Works through the index in windows of games, which are split across the threads and printed in order
+int runReplay(const int argc, char **const argv) {
+    static ArchiveSlice slices[MAX_THREADS];
+    pthread_t threads[MAX_THREADS];
+    bool isThreaded[MAX_THREADS];
+    long threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned long illegalCount = 0;
+    int i = 0, exitValue = 0;
+    Archive archive;
+    struct timespec start;
+    for (; i + 1 < argc && strcmp(argv[i], "--threads") == 0; i += 2) threadCount = atol(argv[i + 1]);
+    if (i >= argc) {
+        puts("Usage: replay [--threads <n>] <archive>");
+        return -1;
+    }
+    if (threadCount < 1) threadCount = 1;
+    if (threadCount > MAX_THREADS) threadCount = MAX_THREADS;
+    if (!openArchive(argv[i], &archive)) {
+        printf("[ERROR] %s is not a game archive.\n", argv[i]);
+        return -1;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (uint64_t window = 0; window < archive.gameCount && !exitValue; window += ARCHIVE_WINDOW_GAMES) {
+        const uint64_t windowEnd = archive.gameCount - window > ARCHIVE_WINDOW_GAMES ? window + ARCHIVE_WINDOW_GAMES : archive.gameCount;
+        int sliceCount = 0;
+        for (uint64_t first = window; sliceCount < threadCount && first < windowEnd; ++sliceCount) {
+            ArchiveSlice *const slice = &slices[sliceCount];
+            slice->archive = &archive;
+            slice->fileName = argv[i];
+            slice->first = first;
+            slice->last = first = first + (windowEnd - first + (threadCount - sliceCount) - 1) / (threadCount - sliceCount);
+            slice->output.length = slice->illegalCount = 0;
+            slice->failed = false;
+            // A slice without a thread of its own is worked through right away
+            if (!(isThreaded[sliceCount] = !pthread_create(&threads[sliceCount], NULL, archiveWorker, slice))) archiveWorker(slice);
+        }
+        for (int j = 0; j < sliceCount; ++j) {
+            if (isThreaded[j]) pthread_join(threads[j], NULL);
+            if (slices[j].failed) {
+                puts("[ERROR] Ran out of memory while replaying the games.");
+                exitValue = -1;
+            }
+            fwrite(slices[j].output.text, 1, slices[j].output.length, stdout);
+            illegalCount += slices[j].illegalCount;
+        }
+    }
+    const double seconds = elapsedSeconds(&start);
+    fprintf(stderr, "%llu games, %lu with illegal moves, %.0f games per second\n", (unsigned long long)archive.gameCount, illegalCount, archive.gameCount / (seconds > 0 ? seconds : 1e-9));
+    for (int j = 0; j < threadCount; ++j) free(slices[j].output.text);
+    munmap((void *)archive.data, archive.size);
+    return exitValue || illegalCount ? -1 : 0;
+}
+
+// Usage: unpack <archive> [<first game> [<count>]]. Writes the games back as PGN, with the clock times and evaluations as comments
+int runUnpack(const int argc, char **const argv) {
+    Archive archive;
+    ArchiveGame game;
+    GameState state;
+    LegalMoves legal = {0};
+    Undo undo;
+    char fenStr[BUFFER_SIZE], formatMove[MAX_MOVE_SIZE];
+    int exitValue = 0;
+    if (argc < 1) {
+        puts("Usage: unpack <archive> [<first game> [<count>]]");
+        return -1;
+    }
+    if (!openArchive(argv[0], &archive)) {
+        printf("[ERROR] %s is not a game archive.\n", argv[0]);
+        return -1;
+    }
+    const uint64_t first = argc > 1 ? strtoull(argv[1], NULL, 10) - 1 : 0;
+    if (argc > 1 && first >= archive.gameCount) {
+        printf("[ERROR] %s has no such game: %s.\n", argv[0], argv[1]);
+        munmap((void *)archive.data, archive.size);
+        return -1;
+    }
+    uint64_t last = argc > 2 ? first + strtoull(argv[2], NULL, 10) : archive.gameCount;
+    if (last > archive.gameCount) last = archive.gameCount;
+    for (uint64_t number = first; number < last; ++number) {
+        bool hasResult = false;
+        if (!readArchiveGame(&archive, number, &game)) {
+            fprintf(stderr, "[ERROR] Game %llu of %s is damaged.\n", (unsigned long long)number + 1, argv[0]);
+            exitValue = -1;
+            continue;
+        }
+        // The result is written after the Black tag, where it stands in the seven tag roster
+        for (const char *tag = (const char *)game.tags; tag < (const char *)game.tags + game.tagsLength;) {
+            const char *const value = tag + strlen(tag) + 1;
+            printf("[%s \"%s\"]\n", tag, value);
+            if (strcmp(tag, Black) == 0 && !hasResult) hasResult = printf("[Result \"%s\"]\n", game.result);
+            tag = value + strlen(value) + 1;
+        }
+        if (!hasResult) printf("[Result \"%s\"]\n", game.result);
+        if (game.fen) snprintf(fenStr, sizeof(fenStr), "%.*s", game.fenLength, game.fen);
+        else strcpy(fenStr, START_POSITION);
+        if (game.fen) printf("[SetUp \"1\"]\n[FEN \"%s\"]\n", fenStr);
+        putchar('\n');
+        if (!setPosition(fenStr, &state)) game.plyCount = 0;
+        for (int ply = 0; ply < game.plyCount; ++ply) {
+            const uint32_t clock = game.clocks ? readBytes(game.clocks + 4 * ply, 4) : NO_CLOCK;
+            const int eval = game.evals ? (int16_t)readBytes(game.evals + 2 * ply, 2) : NO_EVAL;
+            if (state.moveCounter % 2 == 0) printf("%d.", state.moveCounter / 2);
+            else if (ply == 0) printf("%d...", state.moveCounter / 2);
+            if (!playAlgebraic(&state, &legal, readBytes(game.moves + 2 * ply, 2), &undo, formatMove)) {
+                fprintf(stderr, "[ERROR] Game %llu of %s has an illegal move at ply %d.\n", (unsigned long long)number + 1, argv[0], ply + 1);
+                exitValue = -1;
+                break;
+            }
+            fputs(formatMove, stdout);
+            if (eval != NO_EVAL || clock != NO_CLOCK) {
+                fputs(" {", stdout);
+                if (eval != NO_EVAL && abs(eval) >= MATE_SCORE - 1000) printf("[%%eval #%d]", eval > 0 ? MATE_SCORE - eval : -(MATE_SCORE + eval));
+                else if (eval != NO_EVAL) printf("[%%eval %.2f]", eval / 100.0);
+                if (eval != NO_EVAL && clock != NO_CLOCK) putchar(' ');
+                if (clock != NO_CLOCK) {
+                    printf("[%%clk %u:%02u:%02u", clock / 360000, clock / 6000 % 60, clock / 100 % 60);
+                    if (clock % 10) printf(".%02u", clock % 100);
+                    else if (clock % 100) printf(".%u", clock / 10 % 10);
+                    putchar(']');
+                }
+                putchar('}');
+            }
+            putchar(' ');
+        }
+        printf("%s\n\n", game.result);
+    }
+    munmap((void *)archive.data, archive.size);
+    return exitValue;
+}
+
+uint64_t readBigEndian(const unsigned char *const restrict from, const int size) {
+    uint64_t value = 0;
+    for (int i = 0; i < size; ++i) value = value << 8 | from[i];
+    return value;
+}
+
+// Starts from the standard keys, so books written by other programs and by runBook are probed alike; loadPolyglotKeys can replace them
+void initializePolyglotKeys(void) {
+    memcpy(polyglotKeys, polyglotRandom, sizeof(polyglotKeys));
+}
+
+// Replaces the keys with 781 read from any text holding them as 16 digit hexadecimal numbers, for books hashed with other keys
+bool loadPolyglotKeys(const char *const restrict fileName) {
+    uint64_t keys[POLYGLOT_KEY_COUNT];
+    char token[BUFFER_SIZE];
+    int count = 0;
+    FILE *const file = fopen(fileName, "r");
+    if (!file) return false;
+    while (count < POLYGLOT_KEY_COUNT && fscanf(file, "%*[^0-9a-fA-F]") != EOF && fscanf(file, "%99[0-9a-fA-FxX]", token) == 1) {
+        const char *const digits = token[0] == '0' && tolower(token[1]) == 'x' ? token + 2 : token;
+        if (strlen(digits) == 16 && !strpbrk(digits, "xX")) keys[count++] = strtoull(digits, NULL, 16);
+    }
+    fclose(file);
+    if (count < POLYGLOT_KEY_COUNT) return false;
+    memcpy(polyglotKeys, keys, sizeof(keys));
     return true;
 }
 
-bool resize(GameLog *restrict game) {
-    Chunk *tmp = realloc(game->log, sizeof(Chunk) * (++game->chunkCount + 1));
-    if (!tmp) {
-        --game->chunkCount;
-        puts("\n[ERROR] Unable to resize game log.");
+bool openBook(const char *const restrict fileName) {
+    struct stat info;
+    const int file = open(fileName, O_RDONLY);
+    if (file < 0 || fstat(file, &info) < 0 || info.st_size < 16) {
+        if (file >= 0) close(file);
         return false;
     }
-    game->log = tmp;
+    const unsigned char *const entries = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (entries == MAP_FAILED) return false;
+    if (openingBook.entries) munmap((void *)openingBook.entries, openingBook.count * 16);
+    openingBook = (Book){ entries, info.st_size / 16, time(NULL) | 1 };
     return true;
 }
 
-bool logMove(GameLog *game, GameState *state, const bool isCheck, const bool specifyRow, const bool specifyCol) {
-    const Move move = state->move;
-    const int dRow = move.destination.row, dCol = move.destination.col;
-    if (move.type == RESIGN || move.type == PLAYERDRAW) return true;
-    if (game->moveCounter >= 50) {
-        if (!resize(game)) return false;
-        game->moveCounter = 0;
+uint64_t polyglotKey(const GameState *const restrict state) {
+    const Bitboards *const bitboards = &(state->bitboards);
+    const bool isWhite = state->status == WHITE;
+    uint64_t key = isWhite ? polyglotKeys[780] : 0;
+    // Polyglot numbers the squares from a1 and orders the pieces as black pawn, white pawn, black knight and so on
+    for (int side = WHITE; side <= BLACK; ++side)
+        for (int set = PAWNS; set <= KINGS; ++set)
+            for (Bitboard pieces = bitboards->pieces[side][set]; pieces; pieces &= pieces - 1) key ^= polyglotKeys[64 * (2 * set + (side == WHITE)) + (lsb(pieces) ^ 56)];
+    for (int i = 0; i < 4; ++i) if (state->castlingRights & 1 << i) key ^= polyglotKeys[768 + i];
+    if (enPeasantKey(bitboards, state->enPeasant, isWhite)) key ^= polyglotKeys[772 + state->enPeasant % BOARD_SIZE];
+    return key;
+}
+
+// Polyglot writes castling as the king taking its own rook
+uint16_t polyglotMove(const Move move) {
+    const int destination = moveDestination(move) + (moveType(move) == CASTLESHORT) - 2 * (moveType(move) == CASTLELONG);
+    return (destination ^ 56) | (moveOrigin(move) ^ 56) << 6 | (isPromotion(move) ? promotionSet(move) : 0) << 12;
+}
+
+// Finds the entries of the position by binary search on the mapped book and picks one of their legal moves with a probability following its weight
+bool probeBook(const GameState *const restrict state, Move *const restrict move) {
+    MoveList moves;
+    Move candidates[MAX_MOVES];
+    unsigned int weights[MAX_MOVES], total = 0;
+    int count = 0;
+    if (!openingBook.entries) return false;
+    const uint64_t key = polyglotKey(state);
+    size_t low = 0, high = openingBook.count;
+    while (low < high) {
+        const size_t middle = low + (high - low) / 2;
+        if (readBigEndian(openingBook.entries + 16 * middle, 8) < key) low = middle + 1;
+        else high = middle;
     }
-    char formatMove[MAX_MOVE_SIZE];
-    int i = 0;
-    if (move.type == CASTLESHORT) {
-        strcpy(&(formatMove[i]), "O-O");
-        i += 3;
-    } else if (move.type == CASTLELONG) {
-        strcpy(&(formatMove[i]), "O-O-O");
-        i += 5;
-    } else {
-        char piece = toupper(move.pieceMoved);
-        if (piece != PAWN) {
-            formatMove[i++] = piece;
-            if (specifyCol) formatMove[i++] = move.origin.col + 'a';
-            if (specifyRow) formatMove[i++] = '8' - move.origin.row;
+    generateLegalMoves(state, &moves);
+    for (const unsigned char *entry = openingBook.entries + 16 * low; low < openingBook.count && readBigEndian(entry, 8) == key; ++low, entry += 16) {
+        const uint16_t bookMove = readBigEndian(entry + 8, 2);
+        const unsigned int weight = readBigEndian(entry + 10, 2);
+        for (int i = 0; i < moves.count && count < MAX_MOVES; ++i) {
+            if (polyglotMove(moves.moves[i]) != bookMove || !weight) continue;
+            candidates[count] = moves.moves[i];
+            weights[count++] = weight;
+            total += weight;
+            break;
         }
-        if (move.captures) {
-            if (piece == PAWN) formatMove[i++] = move.origin.col + 'a';
-            formatMove[i++] = 'x';
+    }
+    if (!total) return false;
+    unsigned int pick = randomNumber(&openingBook.seed) % total;
+    for (int i = 0; i < count; pick -= weights[i++]) {
+        if (pick >= weights[i]) continue;
+        *move = candidates[i];
+        return true;
+    }
+    return false;
+}
+
+int compareBookEntries(const void *first, const void *second) {
+    const BookEntry *const a = first, *const b = second;
+    if (a->key != b->key) return a->key < b->key ? -1 : 1;
+    return (a->move > b->move) - (a->move < b->move);
+}
+
+// Usage: book <archive> <book> [<plies>]. Collects the first moves of every archived game, weighted by two points for a win and one for a draw of the side making them,
+// and writes them sorted by key as a Polyglot book
+int runBook(const int argc, char **const argv) {
+    Archive archive;
+    ArchiveGame game;
+    GameState start, state;
+    Undo undo;
+    BookEntry *entries = NULL;
+    size_t count = 0, capacity = 0, written = 0;
+    uint32_t highest = 0;
+    if (argc < 2) {
+        puts("Usage: book <archive> <book> [<plies>]");
+        return -1;
+    }
+    const int plies = argc > 2 ? atoi(argv[2]) : BOOK_PLIES;
+    if (!openArchive(argv[0], &archive)) {
+        printf("[ERROR] %s is not a game archive.\n", argv[0]);
+        return -1;
+    }
+    setPosition(START_POSITION, &start);
+    for (uint64_t number = 0; number < archive.gameCount; ++number) {
+        if (!readArchiveGame(&archive, number, &game) || game.fen) continue;
+        const int points[2] = { strcmp(game.result, "1-0") == 0 ? 2 : strcmp(game.result, "0-1") == 0 ? 0 : 1, strcmp(game.result, "0-1") == 0 ? 2 : strcmp(game.result, "1-0") == 0 ? 0 : 1 };
+        state = start;
+        for (int ply = 0; ply < game.plyCount && ply < plies; ++ply) {
+            const Move move = readBytes(game.moves + 2 * ply, 2);
+            MoveList moves;
+            int i = 0;
+            generateLegalMoves(&state, &moves);
+            while (i < moves.count && moves.moves[i] != move) ++i;
+            if (i == moves.count) break;
+            if (count == capacity) {
+                BookEntry *const grown = realloc(entries, (capacity = capacity ? 2 * capacity : 4096) * sizeof(BookEntry));
+                if (!grown) {
+                    puts("[ERROR] Ran out of memory while collecting the moves.");
+                    free(entries);
+                    munmap((void *)archive.data, archive.size);
+                    return -1;
+                }
+                entries = grown;
+            }
+            entries[count++] = (BookEntry){ polyglotKey(&state), polyglotMove(move), points[state.status] };
+            makeMove(&state, move, &undo);
         }
-        formatMove[i++] = dCol + 'a';
-        formatMove[i++] = '8' - dRow;
-        if (move.type == PROMOTION) {
-            formatMove[i++] = '=';
-            formatMove[i++] = toupper(state->board[dRow][dCol]);
+    }
+    munmap((void *)archive.data, archive.size);
+    // Merges the entries of the same move and scales the weights into 16 bits, leaving out moves that never scored
+    qsort(entries, count, sizeof(BookEntry), compareBookEntries);
+    for (size_t i = 0; i < count; ++i) {
+        if (written && entries[written - 1].key == entries[i].key && entries[written - 1].move == entries[i].move) entries[written - 1].weight += entries[i].weight;
+        else entries[written++] = entries[i];
+        if (entries[written - 1].weight > highest) highest = entries[written - 1].weight;
+    }
+    FILE *const file = fopen(argv[1], "wb");
+    if (!file) {
+        printf("[ERROR] Unable to create %s.\n", argv[1]);
+        free(entries);
+        return -1;
+    }
+    count = 0;
+    for (size_t i = 0; i < written; ++i) {
+        const unsigned int weight = highest > UINT16_MAX ? (uint64_t)entries[i].weight * UINT16_MAX / highest : entries[i].weight;
+        unsigned char bytes[16] = {0};
+        if (!weight) continue;
+        for (int j = 0; j < 8; ++j) bytes[j] = entries[i].key >> (56 - 8 * j);
+        bytes[8] = entries[i].move >> 8;
+        bytes[9] = entries[i].move;
+        bytes[10] = weight >> 8;
+        bytes[11] = weight;
+        count += fwrite(bytes, 16, 1, file);
+    }
+    free(entries);
+    if (fclose(file)) {
+        printf("[ERROR] Unable to write %s.\n", argv[1]);
+        return -1;
+    }
+    fprintf(stderr, "%lu book entries from %llu games\n", (unsigned long)count, (unsigned long long)archive.gameCount);
+    return 0;
+}
+
+// Packs the pieces of one side, sorted from the strongest, into a number below 36
+int materialCode(const int *const restrict sets, const int count) {
+    if (count == 2) return (sets[0] > sets[1] ? sets[0] : sets[1]) * 6 + (sets[0] > sets[1] ? sets[1] : sets[0]) + 7;
+    return count ? sets[0] + 1 : 0;
+}
+
+// Registers the ending of the kings, a white piece and a second piece of either color, given as PieceSet or -1 for none
+void addBitbase(const int first, const int second, const bool isSecondBlack) {
+    Bitbase *const bitbase = &bitbases[bitbaseCount];
+    const int white[2] = { first, second };
+    int length = 0;
+    bitbase->name[length++] = 'K';
+    bitbase->name[length++] = PIECE_SYMBOLS[first];
+    if (second >= 0 && !isSecondBlack) bitbase->name[length++] = PIECE_SYMBOLS[second];
+    bitbase->name[length++] = 'K';
+    if (second >= 0 && isSecondBlack) bitbase->name[length++] = PIECE_SYMBOLS[second];
+    bitbase->name[length] = '\0';
+    bitbase->pieces[0] = first;
+    bitbase->pieces[1] = second < 0 ? -1 : second + (isSecondBlack ? 6 : 0);
+    bitbase->pieceCount = second < 0 ? 1 : 2;
+    bitbase->hasPawns = first == PAWNS || second == PAWNS;
+    bitbase->size = (uint64_t)2 * (bitbase->hasPawns ? 32 : 16) * 64 * (second < 0 ? 64 : 64 * 64);
+    bitbaseOf[materialCode(white, second >= 0 && !isSecondBlack ? 2 : 1)][isSecondBlack ? second + 1 : 0] = bitbaseCount++;
+}
+
+// Every ending with a single piece and with two pieces besides the kings, where white has the stronger pieces
+void initializeBitbases(void) {
+    memset(bitbaseOf, -1, sizeof(bitbaseOf));
+    for (int first = PAWNS; first <= QUEENS; ++first) addBitbase(first, -1, false);
+    for (int first = PAWNS; first <= QUEENS; ++first) {
+        for (int second = PAWNS; second <= first; ++second) {
+            addBitbase(first, second, false);
+            addBitbase(first, second, true);
         }
     }
-    if (isCheck) formatMove[i++] = (state->status == WIN || state->status == LOSE) ? '#' : '+';
-    formatMove[i] = '\0';
-    strcpy(game->log[game->chunkCount][game->moveCounter % 50], formatMove);
-    ++game->moveCounter;
+}
+
+// Finds the ending of the pieces besides the kings, given as PIECE_SYMBOLS indices of either color; flip is set if the stronger ones are black
+Bitbase *findBitbase(const int *const restrict pieces, const int count, bool *const restrict flip) {
+    int sets[2][2], counts[2] = { 0, 0 };
+    if (count < 1 || count > 2) return NULL;
+    for (int i = 0; i < count; ++i) sets[pieces[i] / 6][counts[pieces[i] / 6]++] = pieces[i] % 6;
+    const int codes[2] = { materialCode(sets[WHITE], counts[WHITE]), materialCode(sets[BLACK], counts[BLACK]) };
+    *flip = counts[BLACK] > counts[WHITE] || (counts[BLACK] == counts[WHITE] && codes[BLACK] > codes[WHITE]);
+    const int entry = bitbaseOf[codes[*flip]][codes[!*flip]];
+    return entry < 0 ? NULL : &bitbases[entry];
+}
+
+// The position is mirrored so the white king stands on the files a-d, and without pawns also on the ranks 1-4. The index then counts
+// the side to move, the white king, the black king and the other pieces in the order of the bitbase, identical ones sorted by square
+uint64_t bitbaseIndex(const Bitbase *const restrict bitbase, int whiteKing, int blackKing, const int *const restrict pieceSquares, const bool isWhite) {
+    const int mirror = (whiteKing % BOARD_SIZE > 3 ? 7 : 0) ^ (!bitbase->hasPawns && whiteKing / BOARD_SIZE < 4 ? 56 : 0);
+    int squares[2];
+    for (int i = 0; i < bitbase->pieceCount; ++i) squares[i] = pieceSquares[i] ^ mirror;
+    if (bitbase->pieceCount == 2 && bitbase->pieces[0] == bitbase->pieces[1] && squares[0] > squares[1]) {
+        const int swap = squares[0];
+        squares[0] = squares[1];
+        squares[1] = swap;
+    }
+    whiteKing ^= mirror;
+    blackKing ^= mirror;
+    uint64_t index = (!isWhite) * (bitbase->hasPawns ? 32 : 16) + (whiteKing / BOARD_SIZE - (bitbase->hasPawns ? 0 : 4)) * 4 + whiteKing % BOARD_SIZE;
+    index = index * 64 + blackKing;
+    for (int i = 0; i < bitbase->pieceCount; ++i) index = index * 64 + squares[i];
+    return index;
+}
+
+void decodeBitbaseIndex(const Bitbase *const restrict bitbase, uint64_t index, int *const restrict whiteKing, int *const restrict blackKing, int *const restrict squares, bool *const restrict isWhite) {
+    const int kingCount = bitbase->hasPawns ? 32 : 16;
+    for (int i = bitbase->pieceCount - 1; i >= 0; --i, index /= 64) squares[i] = index % 64;
+    *blackKing = index % 64;
+    index /= 64;
+    *whiteKing = (index % kingCount / 4 + (bitbase->hasPawns ? 0 : 4)) * BOARD_SIZE + index % 4;
+    *isWhite = index < (uint64_t)kingCount;
+}
+
+// Places the pieces of a position of the ending, failing if two share a square, a pawn stands on the first or last rank or two identical pieces are out of order
+bool setUpEnding(const Bitbase *const restrict bitbase, const int whiteKing, const int blackKing, const int *const restrict squares, Bitboards *const restrict bitboards) {
+    if (whiteKing == blackKing) return false;
+    *bitboards = (Bitboards){0};
+    bitboards->pieces[WHITE][KINGS] = bitboards->occupancy[WHITE] = bit(whiteKing);
+    bitboards->pieces[BLACK][KINGS] = bitboards->occupancy[BLACK] = bit(blackKing);
+    bitboards->occupied = bit(whiteKing) | bit(blackKing);
+    bitboards->squares[whiteKing] = KINGS;
+    bitboards->squares[blackKing] = 6 + KINGS;
+    for (int i = 0; i < bitbase->pieceCount; ++i) {
+        const int side = bitbase->pieces[i] / 6, set = bitbase->pieces[i] % 6;
+        if ((bitboards->occupied & bit(squares[i])) || (set == PAWNS && (squares[i] < BOARD_SIZE || squares[i] >= 7 * BOARD_SIZE))) return false;
+        bitboards->pieces[side][set] |= bit(squares[i]);
+        bitboards->occupancy[side] |= bit(squares[i]);
+        bitboards->occupied |= bit(squares[i]);
+        bitboards->squares[squares[i]] = bitbase->pieces[i];
+    }
+    return bitbase->pieceCount < 2 || bitbase->pieces[0] != bitbase->pieces[1] || squares[0] < squares[1];
+}
+
+// Finds the bitbase of the material on the board and the index of the position in it, flipping the colors if black has the stronger pieces
+Bitbase *locateBitbase(const Bitboards *const restrict bitboards, const bool isWhite, uint64_t *const restrict index) {
+    int pieces[4], squares[2][4], counts[2] = { 0, 0 }, count = 0, pieceSquares[2];
+    bool flip;
+    if (popCount(bitboards->occupied) > 4) return NULL;
+    for (int side = WHITE; side <= BLACK; ++side) {
+        for (int set = QUEENS; set >= PAWNS; --set) {
+            for (Bitboard board = bitboards->pieces[side][set]; board; board &= board - 1) {
+                pieces[count++] = side * 6 + set;
+                squares[side][counts[side]++] = lsb(board);
+            }
+        }
+    }
+    Bitbase *const bitbase = findBitbase(pieces, count, &flip);
+    if (!bitbase) return NULL;
+    const int strong = flip ? BLACK : WHITE, weak = flip ? WHITE : BLACK, mirror = flip ? 56 : 0;
+    for (int i = 0; i < counts[strong]; ++i) pieceSquares[i] = squares[strong][i] ^ mirror;
+    for (int i = 0; i < counts[weak]; ++i) pieceSquares[counts[strong] + i] = squares[weak][i] ^ mirror;
+    *index = bitbaseIndex(bitbase, lsb(bitboards->pieces[strong][KINGS]) ^ mirror, lsb(bitboards->pieces[weak][KINGS]) ^ mirror, pieceSquares, isWhite != flip);
+    return bitbase;
+}
+
+// Stores what the side to move gets if the ending is built: 1 for a win, 0 for a draw and -1 for a loss. Castling and en peasant rights are not taken into account
+bool probeBitbase(const Bitboards *const restrict bitboards, const bool isWhite, int *const restrict result) {
+    uint64_t index;
+    if (popCount(bitboards->occupied) == 2) {
+        *result = 0;
+        return true;
+    }
+    const Bitbase *const bitbase = locateBitbase(bitboards, isWhite, &index);
+    if (!bitbase || !bitbase->table) return false;
+    const int value = bitbase->table[index / 4] >> (index % 4 * 2) & 3;
+    *result = value == BITBASEWIN ? 1 : value == BITBASELOSS ? -1 : 0;
     return true;
 }
 
+bool canProbeBitbase(const GameState *const restrict state) {
+    return popCount(state->bitboards.occupied) <= 4 && !state->castlingRights && !enPeasantKey(&state->bitboards, state->enPeasant, state->status == WHITE);
+}
+
+// The best result taking en peasant gets the side to move, or -2 if it can not
+int enPeasantResult(const Bitboards *const restrict bitboards, const bool isWhite, const int enPeasant) {
+    GameState state = { .bitboards = *bitboards, .status = sideOf(isWhite), .enPeasant = enPeasant };
+    MoveList moves;
+    int best = -2, result;
+    updateCheckInfo(&state);
+    generateLegalMoves(&state, &moves);
+    for (int i = 0; i < moves.count; ++i) {
+        Bitboards after = *bitboards;
+        if (moveType(moves.moves[i]) != ENPEASANT) continue;
+        movePieces(&after, moves.moves[i]);
+        if (probeBitbase(&after, !isWhite, &result) && -result > best) best = -result;
+    }
+    return best;
+}
+
+// Retrograde analysis. Every position is first decided by the moves that leave the ending, captures and promotions, which are looked up in the bitbases
+// they lead to, and counts the moves that stay inside. The decided positions are then taken back move by move, one ply further per pass: a position
+// that can move into a loss of the opponent is won, one whose last move not yet known to lose did lose is lost. Whatever is left undecided is drawn.
+// A byte per position holds the BitbaseValue in the top two bits and the count below; a move that draws counts once more so the count never runs out.
+// Bitbases hold no en peasant rights, so a double step the opponent may answer by taking en peasant is worth the better of the two for the opponent
+unsigned char *buildBitbase(const Bitbase *const restrict bitbase) {
+    const uint64_t wordCount = (bitbase->size + 63) / 64;
+    unsigned char *const values = malloc(bitbase->size), *const table = calloc((bitbase->size + 3) / 4, 1);
+    uint64_t *frontier = calloc(wordCount, sizeof(uint64_t)), *next = calloc(wordCount, sizeof(uint64_t));
+    GameState state = { .move = 0 };
+    MoveList moves;
+    bool failed = !values || !table || !frontier || !next, isChanged = true;
+    for (uint64_t index = 0; index < bitbase->size && !failed; ++index) {
+        int whiteKing, blackKing, squares[2], stays = 0, result;
+        bool isWhite, hasDraw = false;
+        BitbaseValue value = UNRESOLVED;
+        decodeBitbaseIndex(bitbase, index, &whiteKing, &blackKing, squares, &isWhite);
+        // Illegal positions count as drawn, no legal position leads to them
+        if (!setUpEnding(bitbase, whiteKing, blackKing, squares, &state.bitboards) || attackersTo(&state.bitboards, isWhite ? blackKing : whiteKing, state.bitboards.occupied, isWhite)) {
+            values[index] = BITBASEDRAW << 6;
+            continue;
+        }
+        state.status = sideOf(isWhite);
+        updateCheckInfo(&state);
+        generateLegalMoves(&state, &moves);
+        for (int i = 0; i < moves.count && value == UNRESOLVED; ++i) {
+            const Move move = moves.moves[i];
+            const bool isLeaving = isCapture(&state.bitboards, move) || isPromotion(move);
+            Bitboards after = state.bitboards;
+            if (!isLeaving && moveType(move) != DOUBLEPAWNMOVE) {
+                ++stays;
+                continue;
+            }
+            movePieces(&after, move);
+            if (!isLeaving) {
+                stays += enPeasantResult(&after, !isWhite, (moveOrigin(move) + moveDestination(move)) / 2) != 1;
+                continue;
+            }
+            if (!probeBitbase(&after, !isWhite, &result)) failed = true;
+            else if (result < 0) value = BITBASEWIN;
+            hasDraw |= result == 0;
+        }
+        if (value == UNRESOLVED && !moves.count) value = state.checkers ? BITBASELOSS : BITBASEDRAW;
+        else if (value == UNRESOLVED && !stays) value = hasDraw ? BITBASEDRAW : BITBASELOSS;
+        values[index] = value << 6 | (value == UNRESOLVED ? stays + hasDraw : 0);
+        if (value == BITBASEWIN || value == BITBASELOSS) frontier[index / 64] |= bit(index % 64);
+    }
+    while (isChanged && !failed) {
+        isChanged = false;
+        for (uint64_t word = 0; word < wordCount; ++word) {
+            for (Bitboard decided = frontier[word]; decided; decided &= decided - 1) {
+                const uint64_t index = word * 64 + lsb(decided);
+                const bool isLoss = values[index] >> 6 == BITBASELOSS;
+                int whiteKing, blackKing, squares[2];
+                bool isWhite;
+                Bitboards position;
+                decodeBitbaseIndex(bitbase, index, &whiteKing, &blackKing, squares, &isWhite);
+                setUpEnding(bitbase, whiteKing, blackKing, squares, &position);
+                const int mover = sideOf(!isWhite);
+                // Takes back every move of the side that just moved, the king first and then its other pieces; pawns only step back, never from their first rank
+                for (int piece = -1; piece < bitbase->pieceCount; ++piece) {
+                    const int from = piece < 0 ? (mover == WHITE ? whiteKing : blackKing) : squares[piece], set = piece < 0 ? KINGS : bitbase->pieces[piece] % 6;
+                    const int back = mover == WHITE ? BOARD_SIZE : -BOARD_SIZE, row = from / BOARD_SIZE;
+                    Bitboard targets = 0;
+                    if (piece >= 0 && bitbase->pieces[piece] / 6 != mover) continue;
+                    if (set != PAWNS) targets = attacksFrom(set, from, position.occupied, mover == WHITE) & ~position.occupied;
+                    else if ((mover == WHITE ? row <= 5 : row >= 2) && !(position.occupied & bit(from + back))) {
+                        targets = bit(from + back);
+                        if (row == (mover == WHITE ? 4 : 3) && !(position.occupied & bit(from + 2 * back))) targets |= bit(from + 2 * back);
+                    }
+                    for (; targets; targets &= targets - 1) {
+                        const int to = lsb(targets);
+                        int kings[2] = { whiteKing, blackKing }, previous[2] = { squares[0], squares[1] }, epResult;
+                        Bitboards before = position;
+                        before.pieces[mover][set] ^= bit(from) | bit(to);
+                        before.occupancy[mover] ^= bit(from) | bit(to);
+                        before.occupied ^= bit(from) | bit(to);
+                        if (attackersTo(&before, isWhite ? kings[WHITE] : kings[BLACK], before.occupied, mover == WHITE)) continue;
+                        if (piece < 0) kings[mover] = to;
+                        else previous[piece] = to;
+                        const uint64_t predecessor = bitbaseIndex(bitbase, kings[WHITE], kings[BLACK], previous, mover == WHITE);
+                        if (values[predecessor] >> 6 != UNRESOLVED) continue;
+                        // Taking en peasant after the double step either wins, so the step was never counted, or draws, which keeps the step from losing
+                        if (set == PAWNS && abs(to - from) == 2 * BOARD_SIZE && (epResult = enPeasantResult(&position, isWhite, (from + to) / 2)) >= 0) {
+                            if (epResult == 1 || (epResult == 0 && isLoss)) continue;
+                        }
+                        if (isLoss) values[predecessor] = BITBASEWIN << 6;
+                        else if (--values[predecessor] == 0) values[predecessor] = BITBASELOSS << 6;
+                        else continue;
+                        next[predecessor / 64] |= bit(predecessor % 64);
+                        isChanged = true;
+                    }
+                }
+            }
+        }
+        uint64_t *const swap = frontier;
+        frontier = next;
+        next = swap;
+        memset(next, 0, wordCount * sizeof(uint64_t));
+    }
+    for (uint64_t index = 0; index < bitbase->size && !failed; ++index) {
+        const int value = values[index] >> 6;
+        if (value == BITBASEWIN || value == BITBASELOSS) table[index / 4] |= value << (index % 4 * 2);
+    }
+    free(values);
+    free(frontier);
+    free(next);
+    if (!failed) return table;
+    free(table);
+    return NULL;
+}
+
+// A file per ending: the magic, the number of positions and the table
+bool saveBitbase(const Bitbase *const restrict bitbase, const char *const restrict directory) {
+    char path[BUFFER_SIZE * 2], header[16];
+    snprintf(path, sizeof(path), "%s/%s.bb", directory, bitbase->name);
+    memcpy(header, BITBASE_MAGIC, 8);
+    putBytes(&header[8], bitbase->size, 8);
+    mkdir(directory, 0777);
+    FILE *const file = fopen(path, "wb");
+    if (!file) return false;
+    const bool isWritten = fwrite(header, 1, 16, file) == 16 && fwrite(bitbase->table, 1, (bitbase->size + 3) / 4, file) == (bitbase->size + 3) / 4;
+    return !fclose(file) && isWritten;
+}
+
+bool loadBitbase(Bitbase *const restrict bitbase, const char *const restrict directory) {
+    char path[BUFFER_SIZE * 2];
+    struct stat info;
+    snprintf(path, sizeof(path), "%s/%s.bb", directory, bitbase->name);
+    const int file = open(path, O_RDONLY);
+    if (file < 0) return false;
+    if (fstat(file, &info) < 0 || (uint64_t)info.st_size != 16 + (bitbase->size + 3) / 4) {
+        close(file);
+        return false;
+    }
+    const unsigned char *const data = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+    close(file);
+    if (data == MAP_FAILED) return false;
+    if (memcmp(data, BITBASE_MAGIC, 8) != 0 || readBytes(data + 8, 8) != bitbase->size) {
+        munmap((void *)data, info.st_size);
+        return false;
+    }
+    bitbase->table = data + 16;
+    bitbase->mappedSize = info.st_size;
+    return true;
+}
+
+// Checks whether the endings every capture and promotion leads to are built, and marks the missing ones as wanted if asked to
+bool dependenciesBuilt(const Bitbase *const restrict bitbase, const bool mark, BitbaseJob *const restrict job) {
+    bool isBuilt = true, flip;
+    for (int i = 0; i < bitbase->pieceCount; ++i) {
+        // Either the piece is captured or, if it is a pawn, it promotes to a knight up to a queen
+        for (int change = -1; change <= QUEENS; ++change) {
+            int pieces[2] = { bitbase->pieces[0], bitbase->pieces[1] }, count = bitbase->pieceCount;
+            if (change >= 0 && (bitbase->pieces[i] % 6 != PAWNS || change == PAWNS)) continue;
+            if (change < 0) pieces[i] = pieces[--count];
+            else pieces[i] = bitbase->pieces[i] / 6 * 6 + change;
+            Bitbase *const next = findBitbase(pieces, count, &flip);
+            if (!next || next->table) continue;
+            isBuilt = false;
+            if (!mark || job->wanted[next - bitbases]) continue;
+            job->wanted[next - bitbases] = true;
+            dependenciesBuilt(next, true, job);
+        }
+    }
+    return isBuilt;
+}
+
+void *bitbaseWorker(void *argument) {
+    BitbaseJob *const job = argument;
+    pthread_mutex_lock(&job->lock);
+    while (!job->failed) {
+        Bitbase *next = NULL;
+        bool isPending = false;
+        for (int i = 0; i < bitbaseCount && !next; ++i) {
+            if (!job->wanted[i] || bitbases[i].table) continue;
+            isPending = true;
+            if (!bitbases[i].isBuilding && dependenciesBuilt(&bitbases[i], false, job)) next = &bitbases[i];
+        }
+        if (!isPending) break;
+        if (!next) {
+            pthread_cond_wait(&job->changed, &job->lock);
+            continue;
+        }
+        struct timespec start;
+        next->isBuilding = true;
+        pthread_mutex_unlock(&job->lock);
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        const unsigned char *const table = buildBitbase(next);
+        const double seconds = elapsedSeconds(&start);
+        pthread_mutex_lock(&job->lock);
+        next->isBuilding = false;
+        next->table = table;
+        if (!table) {
+            printf("[ERROR] Ran out of memory while building %s.\n", next->name);
+            job->failed = true;
+        } else if (job->directory && job->isQuiet) {
+            saveBitbase(next, job->directory);
+        } else if (job->directory) {
+            if (saveBitbase(next, job->directory)) printf("%s: %llu positions in %.1f s\n", next->name, (unsigned long long)next->size, seconds);
+            else printf("[ERROR] Unable to save %s to %s.\n", next->name, job->directory);
+        }
+        pthread_cond_broadcast(&job->changed);
+    }
+    pthread_mutex_unlock(&job->lock);
+    return NULL;
+}
+
+// Builds every wanted ending, each on one thread once the endings it depends on are done
+bool buildBitbases(BitbaseJob *const restrict job, int threadCount) {
+    pthread_t threads[MAX_THREADS];
+    int started = 0;
+    if (threadCount < 1) threadCount = 1;
+    if (threadCount > MAX_THREADS) threadCount = MAX_THREADS;
+    pthread_mutex_init(&job->lock, NULL);
+    pthread_cond_init(&job->changed, NULL);
+    for (int i = 0; i < threadCount; ++i) if (!pthread_create(&threads[started], NULL, bitbaseWorker, job)) ++started;
+    if (!started) bitbaseWorker(job);
+    for (int i = 0; i < started; ++i) pthread_join(threads[i], NULL);
+    pthread_cond_destroy(&job->changed);
+    pthread_mutex_destroy(&job->lock);
+    return !job->failed;
+}
+
+// Maps the endings cached in the directory and builds the missing ones with three pieces, which only takes a moment, saving them there for the next run;
+// the others are built by runBitbase. An ending that cannot be saved is still used from memory
+void loadBitbases(const char *const restrict directory) {
+    BitbaseJob job = { .directory = directory, .isQuiet = true };
+    for (int i = 0; i < bitbaseCount; ++i) job.wanted[i] = !loadBitbase(&bitbases[i], directory) && bitbases[i].pieceCount == 1;
+    buildBitbases(&job, sysconf(_SC_NPROCESSORS_ONLN));
+}
+
+// Progress of the winning side in a won ending: its material, its pawns close to promotion, the losing king close to the edge and the kings close together
+int mopUp(const Bitboards *const restrict bitboards, const bool isWhite) {
+    const int winner = sideOf(isWhite), loser = sideOf(!isWhite), winnerKing = lsb(bitboards->pieces[winner][KINGS]), loserKing = lsb(bitboards->pieces[loser][KINGS]);
+    int score = 0;
+    for (int set = PAWNS; set < KINGS; ++set) score += (popCount(bitboards->pieces[winner][set]) - popCount(bitboards->pieces[loser][set])) * pieceValues[set];
+    for (Bitboard pawns = bitboards->pieces[winner][PAWNS]; pawns; pawns &= pawns - 1) score += 20 * (isWhite ? 6 - lsb(pawns) / BOARD_SIZE : lsb(pawns) / BOARD_SIZE - 1);
+    score += 5 * (abs(2 * (loserKing % BOARD_SIZE) - 7) + abs(2 * (loserKing / BOARD_SIZE) - 7));
+    score -= 4 * (abs(winnerKing % BOARD_SIZE - loserKing % BOARD_SIZE) + abs(winnerKing / BOARD_SIZE - loserKing / BOARD_SIZE));
+    return score;
+}
+
+// Usage: bitbase [--threads <n>] [--bitbases <directory>] [<ending>...]. Builds the given endings, e.g. KQKR or KPKP, or all of them,
+// together with the endings they depend on, and saves each one to the directory as soon as it is done
+int runBitbase(const int argc, char **const argv) {
+    BitbaseJob job = { .directory = DEFAULT_BITBASE_DIRECTORY };
+    long threadCount = sysconf(_SC_NPROCESSORS_ONLN);
+    int i = 0, builtCount = 0;
+    struct timespec start;
+    for (; i + 1 < argc && argv[i][0] == '-'; i += 2) {
+        if (strcmp(argv[i], "--threads") == 0) threadCount = atol(argv[i + 1]);
+        else if (strcmp(argv[i], "--bitbases") == 0) job.directory = argv[i + 1];
+    }
+    for (int j = 0; j < bitbaseCount; ++j) builtCount += loadBitbase(&bitbases[j], job.directory);
+    for (int j = 0; j < bitbaseCount; ++j) job.wanted[j] = i == argc && !bitbases[j].table;
+    for (; i < argc; ++i) {
+        int j = 0;
+        while (j < bitbaseCount && strcmp(bitbases[j].name, argv[i]) != 0) ++j;
+        if (j == bitbaseCount) {
+            printf("[ERROR] There is no bitbase for %s. Endings are written with the stronger side first, e.g. KQKR.\n", argv[i]);
+            return -1;
+        }
+        if (bitbases[j].table) continue;
+        job.wanted[j] = true;
+        dependenciesBuilt(&bitbases[j], true, &job);
+    }
+    printf("%d endings already built in %s\n", builtCount, job.directory);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    const bool isBuilt = buildBitbases(&job, threadCount);
+    printf("Done in %.1f s\n", elapsedSeconds(&start));
+    return isBuilt ? 0 : -1;
+}
+
+// Usage: --script [<file>], plays the games of the file or of stdin without prompts or boards and writes one line per game: its number, its status,
+// the number of plies and the FEN string of the final position, followed by the first move that could not be played if there is one.
+// Games are separated by empty lines and hold the moves as they would be typed during a game, after an optional line "fen <FEN string>"
+int runScript(const int argc, char **const argv) {
+    FILE *const input = argc > 0 && strcmp(argv[0], "-") != 0 ? fopen(argv[0], "rb") : stdin;
+    static char block[1 << 16];
+    char fenStr[BUFFER_SIZE], word[BUFFER_SIZE], illegalMove[BUFFER_SIZE] = "";
+    TextBuffer text = {0}, output = {0};
+    GameLog gameLog = {0};
+    GameState state;
+    LegalMoves legal = {0};
+    Move move;
+    size_t length;
+    unsigned long gameNumber = 0;
+    bool isPlaying = false, isValid = true, isCheck, failed = false;
+    if (!input) {
+        printf("[ERROR] Unable to open %s.\n", argv[0]);
+        return -1;
+    }
+    while (!failed && (length = fread(block, 1, sizeof(block), input)) > 0) failed = !appendText(&text, block, length);
+    if (input != stdin) fclose(input);
+    setPosition(START_POSITION, &state);
+    if (failed || !initializeGameLog(&gameLog, &state)) {
+        puts("[ERROR] Ran out of memory while reading the games.");
+        free(text.text);
+        freeGameLog(&gameLog);
+        return -1;
+    }
+    for (const char *line = text.text, *const end = text.text + text.length; !failed; ) {
+        const char *const next = line < end ? nextLine(line, end) : end;
+        while (line < next && isspace(*line)) ++line;
+        // An empty line or the end of the input closes the game
+        if (line == next) {
+            if (isPlaying) {
+                if (isValid) writeFEN(&state, word);
+                if (!isValid) failed = !appendFormatted(&output, "%lu invalid FEN \"%s\"\n", gameNumber, fenStr);
+                else if (*illegalMove) failed = !appendFormatted(&output, "%lu %s %d %s illegal move \"%s\"\n", gameNumber, statusNames[state.status], gameLog.moveCount, word, illegalMove);
+                else failed = !appendFormatted(&output, "%lu %s %d %s\n", gameNumber, statusNames[state.status], gameLog.moveCount, word);
+            }
+            if (output.length >= PGN_BATCH_SIZE || (line == end && output.length)) {
+                fwrite(output.text, 1, output.length, stdout);
+                output.length = 0;
+            }
+            isPlaying = false;
+            if (line == end) break;
+            line = next;
+            continue;
+        }
+        if (!isPlaying) {
+            ++gameNumber;
+            isPlaying = true;
+            illegalMove[0] = '\0';
+            strcpy(fenStr, START_POSITION);
+            if (strncmp(line, "fen ", 4) == 0) {
+                snprintf(fenStr, sizeof(fenStr), "%.*s", (int)(next - line - 4 < BUFFER_SIZE ? next - line - 4 : BUFFER_SIZE - 1), line + 4);
+                fenStr[strcspn(fenStr, "\r\n")] = '\0';
+                line = next;
+            }
+            isValid = setPosition(fenStr, &state);
+            if (isValid) {
+                updateCheckInfo(&state);
+                updateGameStatus(&state, &legal, &isCheck);
+            }
+            resetGameLog(&gameLog, &state);
+        }
+        // Moves after the end of the game or after one that could not be played are skipped
+        while (line < next) {
+            const size_t wordLength = strcspn(line, " \t\r\n");
+            snprintf(word, sizeof(word), "%.*s", (int)(wordLength < sizeof(word) ? wordLength : sizeof(word) - 1), line);
+            line += wordLength;
+            while (line < next && isspace(*line)) ++line;
+            const char *san = word;
+            if (!isValid || *illegalMove || (state.status != WHITE && state.status != BLACK)) continue;
+            // Move numbers may stick to the move that follows them, as in "12.Nf3" or "12...Nf6"
+            while (isdigit(*san)) ++san;
+            if (*san == '.') while (*san == '.') ++san;
+            else if (*san) san = word;
+            if (!*san) continue;
+            if (strcmp(san, "undo") == 0 || strcmp(san, "takeback") == 0) {
+                takeBack(&gameLog, &state);
+                continue;
+            }
+            if (strcmp(san, "draw") == 0 || strcmp(san, "resign") == 0) state.move = createMove(strcmp(san, "draw") == 0 ? PLAYERDRAW : RESIGN, 0, 0);
+            else if (!validateMove(san, &state, &legal, &move)) {
+                strcpy(illegalMove, san);
+                continue;
+            } else {
+                Undo *const undo = appendMove(&gameLog, move);
+                if (!undo) {
+                    failed = true;
+                    break;
+                }
+                makeMove(&state, move, undo);
+            }
+            updateGameStatus(&state, &legal, &isCheck);
+        }
+        line = next;
+    }
+    if (failed) puts("[ERROR] Ran out of memory while playing the games.");
+    free(text.text);
+    free(output.text);
+    freeGameLog(&gameLog);
+    return failed ? -1 : 0;
+}
+
+bool initializeGameLog(GameLog *restrict game, const GameState *const restrict start) {
+    game->start = *start;
+    game->first = game->last = calloc(1, sizeof(Chunk));
+    game->count = game->moveCount = 0;
+    return game->first != NULL;
+}
+
+// Starts a new game from the position, keeping the blocks of the last one for its moves
+void resetGameLog(GameLog *const restrict game, const GameState *const restrict start) {
+    game->start = *start;
+    game->last = game->first;
+    game->count = game->moveCount = 0;
+}
+
+// Returns the undo record for makeMove to fill, or NULL if no new block could be allocated
+Undo *appendMove(GameLog *const restrict game, const Move move) {
+    if (game->count == CHUNK_SIZE) {
+        if (!game->last->next) {
+            Chunk *const chunk = calloc(1, sizeof(Chunk));
+            if (!chunk) return NULL;
+            chunk->previous = game->last;
+            game->last->next = chunk;
+        }
+        game->last = game->last->next;
+        game->count = 0;
+    }
+    HistoryEntry *const entry = &game->last->entries[game->count++];
+    entry->move = move;
+    ++game->moveCount;
+    return &entry->undo;
+}
+
+Move lastLoggedMove(const GameLog *const restrict game) {
+    if (!game->moveCount) return 0;
+    return game->count ? game->last->entries[game->count - 1].move : game->last->previous->entries[CHUNK_SIZE - 1].move;
+}
+
+bool takeBack(GameLog *const restrict game, GameState *const restrict state) {
+    if (!game->moveCount) return false;
+    if (!game->count) {
+        game->last = game->last->previous;
+        game->count = CHUNK_SIZE;
+    }
+    unmakeMove(state, &game->last->entries[--game->count].undo);
+    --game->moveCount;
+    return true;
+}
+
+void freeGameLog(GameLog *const restrict game) {
+    for (Chunk *chunk = game->first, *next; chunk; chunk = next) {
+        next = chunk->next;
+        free(chunk);
+    }
+}
+
+// Writes a legal move of the position without its check mark, naming the origin file and/or rank only if another piece of the same type can reach the same square. Returns NULL for a move that is not legal
+char *formatAlgebraic(char *const restrict formatMove, const LegalMoves *const restrict legal, const Move move) {
+    int index = 0, i = 0;
+    while (index < legal->list.count && legal->list.moves[index] != move) ++index;
+    if (index == legal->list.count) return NULL;
+    const uint32_t key = legal->sanKeys[index];
+    const int set = key >> 6 & 7, destination = moveDestination(move);
+    if (key & SAN_CASTLE_MASK) {
+        strcpy(formatMove, moveType(move) == CASTLESHORT ? "O-O" : "O-O-O");
+        return formatMove;
+    }
+    if (set != PAWNS) {
+        bool sameCol = false, sameRow = false, isAmbiguous = false;
+        for (int j = 0; set != KINGS && j < legal->list.count; ++j) {
+            const uint32_t other = legal->sanKeys[j];
+            if (j == index || ((other ^ key) & (SAN_TARGET_MASK | SAN_CASTLE_MASK))) continue;
+            isAmbiguous = true;
+            sameCol |= !((other ^ key) & SAN_COL_MASK);
+            sameRow |= !((other ^ key) & SAN_ROW_MASK);
+        }
+        formatMove[i++] = PIECE_SYMBOLS[set];
+        if (isAmbiguous && (!sameCol || sameRow)) formatMove[i++] = moveOrigin(move) % BOARD_SIZE + 'a';
+        if (isAmbiguous && sameCol) formatMove[i++] = '8' - moveOrigin(move) / BOARD_SIZE;
+    }
+    if (key >> 9 & 1) {
+        if (set == PAWNS) formatMove[i++] = moveOrigin(move) % BOARD_SIZE + 'a';
+        formatMove[i++] = 'x';
+    }
+    formatMove[i++] = destination % BOARD_SIZE + 'a';
+    formatMove[i++] = '8' - destination / BOARD_SIZE;
+    if (isPromotion(move)) {
+        formatMove[i++] = '=';
+        formatMove[i++] = PIECE_SYMBOLS[promotionSet(move)];
+    }
+    formatMove[i] = '\0';
+    return formatMove;
+}
+
+// Plays the move if it is legal and writes it with the disambiguation and check mark it needs, returns NULL otherwise.
+// The legal moves are left at the new position, where they tell a check from a checkmate and are ready for the next move
+char *playAlgebraic(GameState *const restrict state, LegalMoves *const restrict legal, const Move move, Undo *const restrict undo, char *const restrict formatMove) {
+    prepareLegalMoves(state, legal);
+    if (!formatAlgebraic(formatMove, legal, move)) return NULL;
+    makeMove(state, move, undo);
+    prepareLegalMoves(state, legal);
+    if (state->checkers) strcat(formatMove, legal->list.count ? "+" : "#");
+    return formatMove;
+}
+
 void fileWriteFormatted(FILE *stream, char *format, ...) {
    va_list args;
    va_start(args, format);
@@ -1044,7 +4445,10 @@ void fileWriteFormatted(FILE *stream, char *format, ...) {
 
 void createGameFile(GameLog * restrict game, GameStatus status) {
     const char *result = status == WIN ? "1-0" : status == LOSE ? "0-1" : "1/2-1/2";
-    char buffer[BUFFER_SIZE];
+    char buffer[BUFFER_SIZE], formatMove[MAX_MOVE_SIZE];
+    GameState state = game->start;
+    LegalMoves legal = {0};
+    Undo undo;
     int c;
     do {
         GET_INPUT("What name should the game file have? ")
@@ -1062,10 +4466,16 @@ void createGameFile(GameLog * restrict game, GameStatus status) {
         GET_INPUT("Enter the %s player's name: ", i == 0 ? White : Black)
         fileWriteFormatted(file, "\"]\n[%s \"%s", i == 0 ? White : Black, buffer);
     }
+    writeFEN(&state, buffer);
+    if (strcmp(buffer, START_POSITION) != 0) fileWriteFormatted(file, "\"]\n[SetUp \"1\"]\n[FEN \"%s", buffer);
     fputs("\"]\n\n", file);
-    for (int i = 0; i < game->chunkCount * CHUNK_SIZE + game->moveCounter; ++i) {
-        if (i % 2 == 0) fileWriteFormatted(file, "%d.", 1 + i / 2);
-        fputs(game->log[i / CHUNK_SIZE][i % CHUNK_SIZE], file);
+    // Replays the game to write every move with the disambiguation and check marks it needs
+    const Chunk *chunk = game->first;
+    for (int i = 0; i < game->moveCount; ++i) {
+        if (i && i % CHUNK_SIZE == 0) chunk = chunk->next;
+        if (state.moveCounter % 2 == 0) fileWriteFormatted(file, "%d.", state.moveCounter / 2);
+        else if (i == 0) fileWriteFormatted(file, "%d...", state.moveCounter / 2);
+        fputs(playAlgebraic(&state, &legal, chunk->entries[i % CHUNK_SIZE].move, &undo, formatMove), file);
         fputc(' ', file);
     }
     fputs(result, file);